@@ -0,0 +1,37 @@
+/* alloc.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Allocation counting wrappers for benchmarks
+ */
+
+#include "./alloc.h"
+
+alloc_stats_t alloc_stats = {0};
+
+void *__wrap_malloc(size_t size)
+{
+  ++alloc_stats.calls;
+  alloc_stats.bytes += size;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+  ++alloc_stats.calls;
+  alloc_stats.bytes += n * size;
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+  ++alloc_stats.calls;
+  alloc_stats.bytes += size;
+  return __real_realloc(ptr, size);
+}
+
+void *__wrap_reallocarray(void *ptr, size_t n, size_t size)
+{
+  ++alloc_stats.calls;
+  alloc_stats.bytes += n * size;
+  return __real_reallocarray(ptr, n, size);
+}
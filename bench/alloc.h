@@ -0,0 +1,28 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include "../src/lib.h"
+
+/* Allocation counting for benchmarks.  bench.out is linked with
+ * -Wl,--wrap for each allocator below, so every call made from our own
+ * objects goes through a wrapper that counts it before calling the
+ * real allocator. */
+
+typedef struct
+{
+  u64 calls, bytes;
+} alloc_stats_t;
+
+extern alloc_stats_t alloc_stats;
+
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+void *__real_reallocarray(void *, size_t, size_t);
+
+void *__wrap_malloc(size_t);
+void *__wrap_calloc(size_t, size_t);
+void *__wrap_realloc(void *, size_t);
+void *__wrap_reallocarray(void *, size_t, size_t);
+
+#endif
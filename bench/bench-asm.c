@@ -0,0 +1,327 @@
+/* bench-asm.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Throughput benchmark for the assembler on generated sources
+ */
+
+// For getrusage
+#define _DEFAULT_SOURCE
+
+#include "../src/lexer.h"
+#include "../src/lib.h"
+#include "../src/parser.h"
+#include "../src/vm.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#define BENCH_ASM_DEFAULT_LINES 1000000
+#define BENCH_ASM_DEFAULT_FILE  "bench/generated.asm"
+
+void usage(FILE *fp)
+{
+  fputs("./bench-asm.out [OPTIONS]...\n"
+        "\tGenerate a large assembly file then time each stage of\n"
+        "\tassembling it\n"
+        "\t--lines N: Number of lines to generate\n"
+        "\t--seed N: Seed for the generator\n"
+        "\t--file FILE: Where to write the generated source\n",
+        fp);
+}
+
+/* Generator */
+
+u64 rng_state = 0x9E3779B97F4A7C15LU;
+
+u64 rng_next(void)
+{
+  // xorshift64*, deterministic across platforms unlike rand()
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DLU;
+}
+
+u64 rng_below(u64 n)
+{
+  return rng_next() % n;
+}
+
+void gen_push(FILE *fp)
+{
+  const char chars[] = "abcxyzABCXYZ0123456789~!@#$%&()[]{}<>,.:=+";
+  const char *escapes[] = {"\\n", "\\t", "\\r", "\\v", "\\f"};
+  switch (rng_below(9))
+  {
+  case 0:
+    fprintf(fp, "push %" PRIu64, rng_below(1LU << 40));
+    break;
+  case 1:
+    fprintf(fp, "push -%" PRIu64, rng_below(1LU << 40));
+    break;
+  case 2:
+    fprintf(fp, "push %" PRIu64 ".%" PRIu64, rng_below(100000),
+            rng_below(1000));
+    break;
+  case 3:
+    fprintf(fp, "push '%c'", chars[rng_below(ARR_SIZE(chars) - 1)]);
+    break;
+  case 4:
+    fprintf(fp, "push '%s'", escapes[rng_below(ARR_SIZE(escapes))]);
+    break;
+  case 5:
+    fprintf(fp, "push %s", rng_below(2) ? "true" : "false");
+    break;
+  case 6:
+    fprintf(fp, "push nil");
+    break;
+  case 7:
+    fprintf(fp, "push *");
+    break;
+  case 8:
+    fprintf(fp, "push *%" PRIu64, rng_below(4));
+    break;
+  }
+}
+
+// Symbols may not contain digits, so spell label numbers with letters
+void gen_label_name(FILE *fp, u64 n)
+{
+  fputs("label-", fp);
+  do
+  {
+    fputc('a' + (n % 26), fp);
+    n /= 26;
+  } while (n);
+}
+
+// Generates a valid program, returning the number of bytes written
+size_t gen_program(FILE *fp, size_t lines)
+{
+  const char *simple[] = {"noop", "halt", "pop", "plus", "mult", "print"};
+  // Every label is defined exactly once, but may be jumped to before
+  // its definition
+  size_t labels = lines / 64 + 1, defined = 0, instructions = 0;
+
+  fprintf(fp, ";;; Generated by bench-asm.out: %lu lines\n", lines);
+  for (size_t line = 1; line < lines; ++line)
+  {
+    // Leave space to define the remaining labels
+    if (lines - line <= labels - defined ||
+        (defined < labels && rng_below(64) == 0))
+    {
+      fputs("label ", fp);
+      gen_label_name(fp, defined++);
+      fputc('\n', fp);
+      continue;
+    }
+
+    u64 choice = rng_below(32);
+    if (choice < 2)
+    {
+      fprintf(fp, ";; comment %" PRIu64 " with 'quotes' and symbols *.^-\n",
+              rng_next());
+      continue;
+    }
+
+    fputs("  ", fp);
+    if (choice < 12)
+      gen_push(fp);
+    else if (choice < 24)
+      fputs(simple[rng_below(ARR_SIZE(simple))], fp);
+    else if (choice < 27)
+      fprintf(fp, "dup %" PRIu64, rng_below(16));
+    else if (choice < 29)
+    {
+      fputs("jmp ", fp);
+      gen_label_name(fp, rng_below(labels));
+    }
+    else if (choice < 30)
+      fprintf(fp, "jmp %" PRIu64, rng_below(instructions + 1));
+    else
+      fputs("jmp *", fp);
+    ++instructions;
+
+    if (rng_below(4) == 0)
+      fprintf(fp, " ; trailing comment\n");
+    else
+      fputc('\n', fp);
+  }
+  return ftell(fp);
+}
+
+/* Stage timing */
+
+typedef struct
+{
+  const char *name;
+  u64 started, ns;
+  long rss_before, rss_after;
+} stage_t;
+
+long peak_rss_kb(void)
+{
+  struct rusage usage = {0};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+void stage_start(stage_t *stage, const char *name)
+{
+  stage->name       = name;
+  stage->rss_before = peak_rss_kb();
+  stage->started    = time_now_ns();
+}
+
+void stage_stop(stage_t *stage)
+{
+  stage->ns        = time_now_ns() - stage->started;
+  stage->rss_after = peak_rss_kb();
+}
+
+void stage_print(stage_t *stage, size_t bytes)
+{
+  double mb_per_s = stage->ns ? (bytes / 1e6) / (stage->ns / 1e9) : 0;
+  printf("%-20s %12.3f %12.2f %14ld %+14ld\n", stage->name, stage->ns / 1e6,
+         mb_per_s, stage->rss_after, stage->rss_after - stage->rss_before);
+}
+
+bool bench_asm(const char *name)
+{
+  FILE *fp = fopen(name, "rb");
+  if (!fp)
+  {
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET "]: Could not read file `%s`: %s\n",
+            name, strerror(errno));
+    return false;
+  }
+
+  stage_t stages[5] = {0};
+
+  stage_start(stages + 0, "buffer_read_file");
+  buffer_t buffer = buffer_read_file(name, fp);
+  stage_stop(stages + 0);
+  fclose(fp);
+  size_t bytes = buffer.available;
+
+  stage_start(stages + 1, "tokenise_buffer");
+  stream_t stream = {0};
+  lerr_t lerr     = tokenise_buffer(&stream, &buffer);
+  stage_stop(stages + 1);
+  if (lerr != LERR_OK)
+  {
+    char *reason = lerr_generate(lerr, &buffer);
+    fprintf(stderr, "%s\n", reason);
+    free(reason);
+    free(buffer.data);
+    return false;
+  }
+
+  // Same as parse_stream, but timing the fixups on their own
+  stage_start(stages + 2, "parse_emit");
+  emitter_t emitter = {0};
+  emitter_init(&emitter);
+  perr_t perr = PERR_OK;
+  stream_seek_next(&stream);
+  while (!stream_at_end(&stream) && stream_peek(&stream).type != TOKEN_EOF)
+  {
+    pres_t pres = {0};
+    perr        = parse_line(&stream, &pres);
+    if (perr == PERR_OK)
+      perr = emitter_emit(&emitter, &stream, pres);
+    if (perr != PERR_OK)
+      break;
+    stream_seek_next(&stream);
+  }
+  stage_stop(stages + 2);
+
+  size_t fixups = emitter.fixups.used;
+  if (perr == PERR_OK)
+  {
+    stage_start(stages + 3, "emitter_finish");
+    perr = emitter_finish(&emitter, &stream);
+    stage_stop(stages + 3);
+  }
+
+  if (perr != PERR_OK)
+  {
+    char *reason = perr_generate(perr, &stream);
+    fprintf(stderr, "%s\n", reason);
+    free(reason);
+    emitter_free(&emitter);
+    stream_free(&stream);
+    free(buffer.data);
+    return false;
+  }
+
+  vm_t vm = {0};
+  vm_copy_program(&vm, emitter.program.data, emitter.program.used);
+  FILE *sink = fopen("/dev/null", "wb");
+  stage_start(stages + 4, "vm_write_program");
+  vm_write_program(&vm, sink);
+  stage_stop(stages + 4);
+  fclose(sink);
+
+  printf("[" TERM_CYAN "BENCH" TERM_RESET
+         "]: %s: %lu bytes, %lu tokens, %lu instructions, %lu fixups\n",
+         name, bytes, stream.size, emitter.program.used, fixups);
+  printf("%-20s %12s %12s %14s %14s\n", "STAGE", "MS", "MB/S", "PEAK-RSS-KB",
+         "DELTA-KB");
+  u64 total = 0;
+  for (size_t i = 0; i < ARR_SIZE(stages); ++i)
+  {
+    stage_print(stages + i, bytes);
+    total += stages[i].ns;
+  }
+  stage_t all = {.name       = "total",
+                 .ns         = total,
+                 .rss_before = stages[0].rss_before,
+                 .rss_after  = stages[ARR_SIZE(stages) - 1].rss_after};
+  stage_print(&all, bytes);
+
+  vm_free(&vm);
+  emitter_free(&emitter);
+  stream_free(&stream);
+  free(buffer.data);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t lines     = BENCH_ASM_DEFAULT_LINES;
+  const char *name = BENCH_ASM_DEFAULT_FILE;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc)
+      lines = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      rng_state = strtoull(argv[++i], NULL, 10) | 1;
+    else if (strcmp(argv[i], "--file") == 0 && i + 1 < argc)
+      name = argv[++i];
+    else
+    {
+      usage(stderr);
+      return 1;
+    }
+  }
+
+  FILE *fp = fopen(name, "wb");
+  if (!fp)
+  {
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET "]: Could not open file `%s`: %s\n",
+            name, strerror(errno));
+    return 1;
+  }
+  size_t bytes = gen_program(fp, MAX(lines, 2));
+  fclose(fp);
+  printf("[" TERM_CYAN "BENCH" TERM_RESET "]: Generated `%s`: %lu lines, %lu "
+         "bytes\n",
+         name, lines, bytes);
+
+  return bench_asm(name) ? 0 : 1;
+}
@@ -0,0 +1,449 @@
+/* bench.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Benchmarks for the virtual machine
+ */
+
+// For strdup and strndup
+#define _DEFAULT_SOURCE
+
+#include "../src/counters.h"
+#include "./alloc.h"
+#include "../src/lexer.h"
+#include "../src/lib.h"
+#include "../src/parser.h"
+#include "../src/vm.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_BUDGET 10000000
+#define BENCH_DEFAULT_REPEAT 10
+// Percentage change allowed in deterministic metrics before a
+// comparison is considered a regression
+#define BENCH_DEFAULT_THRESHOLD 1.0
+
+void usage(FILE *fp)
+{
+  fputs("./bench.out [OPTIONS]... [FILE]...\n"
+        "\tAssemble each FILE then run it repeatedly for a fixed number of\n"
+        "\tinstructions, reporting the time taken per instruction and,\n"
+        "\twhen the kernel allows it, hardware counters per instruction\n"
+        "\tFILE: File name for assembly code\n"
+        "\t--budget N: Instructions to execute per run\n"
+        "\t--repeat N: Runs per workload\n"
+        "\t--save FILE: Write the results to FILE as a JSON baseline\n"
+        "\t--compare FILE: Compare the results against a baseline\n"
+        "\t--threshold PCT: Allowed change in instruction and allocation\n"
+        "\t\tcounts before --compare fails (default 1%)\n"
+        "\t--time-threshold PCT: Allowed change in time per instruction\n"
+        "\t\tbefore --compare fails (default: not checked)\n",
+        fp);
+}
+
+bool bench_assemble(const char *name, vm_t *vm)
+{
+  FILE *fp = fopen(name, "rb");
+  if (!fp)
+  {
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET "]: Could not read file `%s`: %s\n",
+            name, strerror(errno));
+    return false;
+  }
+  buffer_t buffer = buffer_read_file(name, fp);
+  fclose(fp);
+
+  stream_t stream = {0};
+  lerr_t lerr     = tokenise_buffer(&stream, &buffer);
+  if (lerr != LERR_OK)
+  {
+    char *reason = lerr_generate(lerr, &buffer);
+    fprintf(stderr, "%s\n", reason);
+    free(reason);
+    free(buffer.data);
+    return false;
+  }
+
+  op_t *instructions    = NULL;
+  u64 instructions_size = 0;
+  perr_t perr = parse_stream(&stream, &instructions, &instructions_size);
+  if (perr != PERR_OK)
+  {
+    char *reason = perr_generate(perr, &stream);
+    fprintf(stderr, "%s\n", reason);
+    free(reason);
+    stream_free(&stream);
+    free(buffer.data);
+    return false;
+  }
+  stream_free(&stream);
+  free(buffer.data);
+
+  vm_copy_program(vm, instructions, instructions_size);
+  free(instructions);
+  return true;
+}
+
+typedef struct
+{
+  double mean, stddev;
+} sample_t;
+
+sample_t sample_compute(double *xs, size_t n)
+{
+  sample_t sample = {0};
+  for (size_t i = 0; i < n; ++i)
+    sample.mean += xs[i];
+  sample.mean /= n;
+  for (size_t i = 0; i < n; ++i)
+    sample.stddev += (xs[i] - sample.mean) * (xs[i] - sample.mean);
+  sample.stddev = n > 1 ? sqrt(sample.stddev / (n - 1)) : 0;
+  return sample;
+}
+
+typedef struct
+{
+  char *name;
+  u64 guest_instructions;
+  // Host instructions per run, if the counter was available
+  bool has_host_instructions;
+  u64 host_instructions;
+  // Allocations while assembling, and per run while executing
+  u64 load_allocations, run_allocations;
+  double ns_per_instruction;
+} bench_result_t;
+
+bool bench_run(const char *name, u64 budget, size_t repeat, FILE *sink,
+               counters_t *counters, bench_result_t *result)
+{
+  vm_t vm           = {0};
+  u64 allocs_before = alloc_stats.calls;
+  if (!bench_assemble(name, &vm))
+  {
+    vm_free(&vm);
+    return false;
+  }
+  u64 load_allocations = alloc_stats.calls - allocs_before;
+  vm.output            = sink;
+
+  double *ns_per_inst = calloc(repeat, sizeof(*ns_per_inst));
+  double *ips         = calloc(repeat, sizeof(*ips));
+  u64 retired = 0, total_retired = 0, run_allocations = 0;
+  u64 totals[NUMBER_OF_COUNTERS] = {0};
+  err_t err                      = ERR_OK;
+  for (size_t i = 0; i < repeat && err == ERR_OK; ++i)
+  {
+    vm_reset(&vm);
+    allocs_before = alloc_stats.calls;
+    counters_start(counters);
+    err = vm_execute_n(&vm, budget);
+    counters_stop(counters);
+    run_allocations += alloc_stats.calls - allocs_before;
+    for (size_t j = 0; j < NUMBER_OF_COUNTERS; ++j)
+      totals[j] += counters->values[j];
+    const vm_stats_t *stat = vm_stats(&vm);
+    retired                = stat->retired;
+    total_retired += stat->retired;
+    ns_per_inst[i] = (double)stat->wall_ns / MAX(stat->retired, 1);
+    ips[i]         = stat->wall_ns ? stat->retired * 1e9 / stat->wall_ns : 0;
+  }
+
+  bool success = err == ERR_OK;
+  if (!success)
+    fprintf(stderr, "[" TERM_RED "ERROR" TERM_RESET "]: %s: %s\n", name,
+            err_as_cstr(err));
+  else
+  {
+    sample_t ns = sample_compute(ns_per_inst, repeat);
+    sample_t is = sample_compute(ips, repeat);
+    printf("%-32s %12" PRIu64 " %9.3f ±%7.3f %12.0f ±%10.0f\n", name, retired,
+           ns.mean, ns.stddev, is.mean, is.stddev);
+    // Host events per guest instruction, averaged over every run
+    for (size_t j = 0; j < NUMBER_OF_COUNTERS; ++j)
+      if (counters->available[j])
+        printf("  %-30s %12.3f\n", counter_as_cstr(j),
+               (double)totals[j] / MAX(total_retired, 1));
+
+    *result = (bench_result_t){
+        .name                  = strdup(name),
+        .guest_instructions    = retired,
+        .has_host_instructions = counters->available[COUNTER_INSTRUCTIONS],
+        .host_instructions     = totals[COUNTER_INSTRUCTIONS] / repeat,
+        .load_allocations      = load_allocations,
+        .run_allocations       = run_allocations / repeat,
+        .ns_per_instruction    = ns.mean,
+    };
+  }
+
+  free(ns_per_inst);
+  free(ips);
+  vm_free(&vm);
+  return success;
+}
+
+/* Baselines
+ *
+ * A baseline is a JSON object with one workload object per line, so
+ * reading it back only needs to look for fields within a line. */
+
+bool bench_save(const char *name, bench_result_t *results, size_t size,
+                u64 budget, size_t repeat)
+{
+  FILE *fp = fopen(name, "w");
+  if (!fp)
+  {
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET "]: Could not open file `%s`: %s\n",
+            name, strerror(errno));
+    return false;
+  }
+  fprintf(fp,
+          "{\"budget\": %" PRIu64 ", \"repeat\": %lu, \"workloads\": [\n",
+          budget, repeat);
+  for (size_t i = 0; i < size; ++i)
+  {
+    bench_result_t *res = results + i;
+    fprintf(fp, "  {\"workload\": \"%s\", \"guest_instructions\": %" PRIu64,
+            res->name, res->guest_instructions);
+    if (res->has_host_instructions)
+      fprintf(fp, ", \"host_instructions\": %" PRIu64, res->host_instructions);
+    else
+      fprintf(fp, ", \"host_instructions\": null");
+    fprintf(fp,
+            ", \"load_allocations\": %" PRIu64
+            ", \"run_allocations\": %" PRIu64
+            ", \"ns_per_instruction\": %.3f}%s\n",
+            res->load_allocations, res->run_allocations,
+            res->ns_per_instruction, i + 1 < size ? "," : "");
+  }
+  fprintf(fp, "]}\n");
+  fclose(fp);
+  return true;
+}
+
+// Points to the value of KEY in LINE, or NULL if KEY isn't present
+const char *bench_field(const char *line, const char *key)
+{
+  char pattern[64];
+  snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+  const char *field = strstr(line, pattern);
+  return field ? field + strlen(pattern) : NULL;
+}
+
+bool bench_field_u64(const char *line, const char *key, u64 *value)
+{
+  const char *field = bench_field(line, key);
+  return field && sscanf(field, "%" SCNu64, value) == 1;
+}
+
+// Reads every workload of a baseline into a darr_t of bench_result_t
+bool bench_load(const char *name, darr_t *results, u64 *budget)
+{
+  FILE *fp = fopen(name, "r");
+  if (!fp)
+  {
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET "]: Could not open file `%s`: %s\n",
+            name, strerror(errno));
+    return false;
+  }
+  darr_init(results, DARR_INITAL_SIZE, sizeof(bench_result_t));
+  char line[1024];
+  while (fgets(line, sizeof(line), fp))
+  {
+    bench_field_u64(line, "budget", budget);
+    const char *workload = bench_field(line, "workload");
+    const char *ns       = bench_field(line, "ns_per_instruction");
+    if (!workload || *workload != '"' || !ns)
+      continue;
+    ++workload;
+    bench_result_t res = {0};
+    res.name           = strndup(workload, strcspn(workload, "\""));
+    bench_field_u64(line, "guest_instructions", &res.guest_instructions);
+    res.has_host_instructions =
+        bench_field_u64(line, "host_instructions", &res.host_instructions);
+    bench_field_u64(line, "load_allocations", &res.load_allocations);
+    bench_field_u64(line, "run_allocations", &res.run_allocations);
+    res.ns_per_instruction = strtod(ns, NULL);
+    DARR_APP(results, bench_result_t, res);
+  }
+  fclose(fp);
+  return true;
+}
+
+double bench_change(double baseline, double current)
+{
+  if (baseline == current)
+    return 0;
+  else if (baseline == 0)
+    return 100;
+  return (current - baseline) * 100 / baseline;
+}
+
+// Prints one row of the comparison table, returning true if the change
+// is within THRESHOLD.  A negative threshold is never exceeded.
+bool bench_compare_metric(const char *workload, const char *metric,
+                          double baseline, double current, double threshold)
+{
+  double change  = bench_change(baseline, current);
+  bool regressed = threshold >= 0 && change > threshold;
+  printf("%-32s %-20s %14.3f %14.3f %+9.2f%% %s\n", workload, metric, baseline,
+         current, change,
+         regressed ? "[" TERM_RED "REGRESSED" TERM_RESET "]"
+         : change < -MAX(threshold, 0)
+             ? "[" TERM_GREEN "IMPROVED" TERM_RESET "]"
+             : "");
+  return !regressed;
+}
+
+// Returns false if any workload regressed past a threshold
+bool bench_compare(const char *name, bench_result_t *results, size_t size,
+                   u64 budget, double threshold, double time_threshold)
+{
+  darr_t baseline     = {0};
+  u64 baseline_budget = budget;
+  if (!bench_load(name, &baseline, &baseline_budget))
+    return false;
+  if (baseline_budget != budget)
+    fprintf(stderr,
+            "[" TERM_RED "WARNING" TERM_RESET "]: `%s` was recorded with "
+            "budget=%" PRIu64 ", instruction counts will differ\n",
+            name, baseline_budget);
+
+  printf("\n[" TERM_CYAN "BENCH" TERM_RESET "]: Comparing against `%s`\n",
+         name);
+  printf("%-32s %-20s %14s %14s %10s\n", "WORKLOAD", "METRIC", "BASELINE",
+         "CURRENT", "CHANGE");
+  bool success = true;
+  for (size_t i = 0; i < size; ++i)
+  {
+    bench_result_t *cur = results + i, *base = NULL;
+    for (size_t j = 0; j < baseline.used && !base; ++j)
+      if (strcmp(DARR_MEMBER(&baseline, bench_result_t, j).name, cur->name) ==
+          0)
+        base = &DARR_MEMBER(&baseline, bench_result_t, j);
+    if (!base)
+    {
+      printf("%-32s (not in baseline)\n", cur->name);
+      continue;
+    }
+
+    success = bench_compare_metric(cur->name, "guest_instructions",
+                                   base->guest_instructions,
+                                   cur->guest_instructions, threshold) &&
+              success;
+    if (base->has_host_instructions && cur->has_host_instructions)
+      success = bench_compare_metric(cur->name, "host_instructions",
+                                     base->host_instructions,
+                                     cur->host_instructions, threshold) &&
+                success;
+    success = bench_compare_metric(cur->name, "load_allocations",
+                                   base->load_allocations,
+                                   cur->load_allocations, threshold) &&
+              success;
+    success = bench_compare_metric(cur->name, "run_allocations",
+                                   base->run_allocations, cur->run_allocations,
+                                   threshold) &&
+              success;
+    success = bench_compare_metric(cur->name, "ns_per_instruction",
+                                   base->ns_per_instruction,
+                                   cur->ns_per_instruction, time_threshold) &&
+              success;
+  }
+
+  for (size_t i = 0; i < baseline.used; ++i)
+    free(DARR_MEMBER(&baseline, bench_result_t, i).name);
+  darr_free(&baseline);
+  return success;
+}
+
+int main(int argc, char *argv[])
+{
+  u64 budget    = BENCH_DEFAULT_BUDGET;
+  size_t repeat = BENCH_DEFAULT_REPEAT;
+  int first     = 1;
+  const char *save_name = NULL, *compare_name = NULL;
+  double threshold = BENCH_DEFAULT_THRESHOLD, time_threshold = -1;
+
+  for (; first < argc && argv[first][0] == '-'; ++first)
+  {
+    if (strcmp(argv[first], "--budget") == 0 && first + 1 < argc)
+      budget = strtoull(argv[++first], NULL, 10);
+    else if (strcmp(argv[first], "--repeat") == 0 && first + 1 < argc)
+      repeat = strtoull(argv[++first], NULL, 10);
+    else if (strcmp(argv[first], "--save") == 0 && first + 1 < argc)
+      save_name = argv[++first];
+    else if (strcmp(argv[first], "--compare") == 0 && first + 1 < argc)
+      compare_name = argv[++first];
+    else if (strcmp(argv[first], "--threshold") == 0 && first + 1 < argc)
+      threshold = strtod(argv[++first], NULL);
+    else if (strcmp(argv[first], "--time-threshold") == 0 && first + 1 < argc)
+      time_threshold = strtod(argv[++first], NULL);
+    else
+    {
+      usage(stderr);
+      return 1;
+    }
+  }
+
+  if (first == argc || budget == 0 || repeat == 0)
+  {
+    usage(stderr);
+    return 1;
+  }
+
+  // Printing workloads shouldn't be measuring the terminal
+  FILE *sink = fopen("/dev/null", "w");
+  if (!sink)
+  {
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET
+            "]: Could not open `/dev/null`: %s\n",
+            strerror(errno));
+    return 1;
+  }
+
+  counters_t counters = {0};
+  if (!counters_open(&counters))
+    fprintf(stderr, "[" TERM_RED "WARNING" TERM_RESET
+                    "]: Hardware counters are unavailable, timing only\n");
+
+  printf("[" TERM_CYAN "BENCH" TERM_RESET "]: budget=%" PRIu64
+         " instructions, repeat=%lu\n",
+         budget, repeat);
+  printf("%-32s %12s %20s %25s\n", "WORKLOAD", "INSTRUCTIONS", "NS/INST",
+         "INST/S");
+
+  bool success   = true;
+  darr_t results = {0};
+  darr_init(&results, argc - first, sizeof(bench_result_t));
+  for (int i = first; i < argc; ++i)
+  {
+    bench_result_t result = {0};
+    if (bench_run(argv[i], budget, repeat, sink, &counters, &result))
+    {
+      DARR_APP(&results, bench_result_t, result);
+    }
+    else
+      success = false;
+  }
+  counters_close(&counters);
+  fclose(sink);
+
+  if (save_name)
+    success =
+        bench_save(save_name, results.data, results.used, budget, repeat) &&
+        success;
+  if (compare_name)
+    success = bench_compare(compare_name, results.data, results.used, budget,
+                            threshold, time_threshold) &&
+              success;
+
+  for (size_t i = 0; i < results.used; ++i)
+    free(DARR_MEMBER(&results, bench_result_t, i).name);
+  darr_free(&results);
+  return success ? 0 : 1;
+}
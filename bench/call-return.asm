@@ -0,0 +1,21 @@
+;;; Benchmark: calling a routine and returning with `jmp *`, modelled
+;;; on print-data from examples/fib.asm (without the printing)
+
+  push 1
+  push 1
+
+  label loop
+  push *1
+  jmp routine
+  push *1
+  jmp routine
+  jmp loop
+
+  ;; Routine that copies the top of the stack (without altering data)
+  ;; then returns to the caller
+  label routine
+  dup 1
+  pop
+  push '\n'
+  pop
+  jmp *
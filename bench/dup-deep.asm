@@ -0,0 +1,31 @@
+;;; Benchmark: duplicating values from deep within the stack
+
+  push 0
+  push 1
+  push 2
+  push 3
+  push 4
+  push 5
+  push 6
+  push 7
+  push 8
+  push 9
+  push 10
+  push 11
+  push 12
+  push 13
+  push 14
+  push 15
+
+  label loop
+  dup 15
+  pop
+  dup 8
+  pop
+  dup 3
+  dup 15
+  pop
+  pop
+  dup 0
+  pop
+  jmp loop
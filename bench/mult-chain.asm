@@ -0,0 +1,20 @@
+;;; Benchmark: chains of integer multiplication, the values never
+;;; change so the loop can run forever
+
+  push 1
+  push 1
+
+  label loop
+  dup 1
+  push 1
+  mult
+  push 1
+  mult
+  push 1
+  mult
+  pop
+  push 1
+  mult
+  push 1
+  mult
+  jmp loop
@@ -0,0 +1,8 @@
+;;; Benchmark: tight integer addition loop
+
+  push 0
+
+  label loop
+  push 1
+  plus
+  jmp loop
@@ -0,0 +1,18 @@
+;;; Benchmark: printing characters, integers and floats
+
+  push 'a'
+  push 1234567
+  push 3.14
+
+  label loop
+  print
+  dup 1
+  print
+  pop
+  dup 2
+  print
+  pop
+  push '\n'
+  print
+  pop
+  jmp loop
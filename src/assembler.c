@@ -4,51 +4,175 @@
  * Description: Compiles assembly to bytecode
  */
 
+#include "./cache.h"
 #include "./lib.h"
+#include "./object.h"
 #include "./op.h"
+#include "./optimiser.h"
+#include "./parallel.h"
 #include "./parser.h"
+#include "./pipeline.h"
+#include "./profile.h"
 #include "./vm.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <string.h>
 
 void usage(FILE *fp)
 {
-  fputs("./assembler.out [FILE] [OUTPUT]?\n"
+  fputs("./assembler.out [-c]? [-O]? [--layout PROFILE]? [--stream]? "
+        "[--jobs N]? [--pipeline]? [--cache CACHE]? [FILE] [OUTPUT]?\n"
         "\tAssemble FILE into bytecode, stored at OUTPUT\n"
-        "\tFILE: File name for assembly code\n"
-        "\tOUTPUT: Optional file name for bytecode storage (will be "
-        "overwritten)\n",
+        "\t-c: Compile FILE into a relocatable object for linker.out, "
+        "leaving labels it doesn't define to other objects\n"
+        "\t-O: Optimise the bytecode (peephole, constant folding, jump "
+        "threading and unreachable code), reporting how many instructions "
+        "were removed (not with -c)\n"
+        "\t--layout PROFILE: Reorder basic blocks so the jumps taken most "
+        "in PROFILE (from interpreter.out --profile on the bytecode of FILE "
+        "without -O) fall through, and code never run goes last\n"
+        "\t--stream: Lex FILE as it's parsed, in constant memory, rather "
+        "than reading it all first\n"
+        "\t--jobs N: Assemble large files in N pieces at once (default is "
+        "the number of processors, 1 to disable)\n"
+        "\t--pipeline: Lex, parse and emit FILE on separate threads at "
+        "once, reporting how long each waited on the others\n"
+        "\t--cache CACHE: Only reassemble the parts of FILE which changed "
+        "since the last run with the same CACHE file\n"
+        "\tFILE: File name for assembly code, - for standard input "
+        "(streamed, needs OUTPUT)\n"
+        "\tOUTPUT: Optional file name for bytecode (or object) storage "
+        "(will be overwritten)\n",
         fp);
 }
 
-void gen_output_filename(const char *name, size_t name_size, char *buffer)
+void gen_output_filename(const char *name, size_t name_size, char *buffer,
+                         const char *extension)
 {
   memcpy(buffer, name, name_size + 1);
   char *ext = strstr(buffer, ".asm");
-  memcpy(ext, ".out", 4);
+  memcpy(ext, extension, 4);
+}
+
+void assemble_optimise(emitter_t *emitter)
+{
+  optimiser_stats_t stats = {0};
+  size_t size             = emitter->program.used;
+  size_t removed          = optimiser_run(emitter, &stats);
+  printf("[" TERM_CYAN "OPTIMISER" TERM_RESET
+         "]: Removed %lu of %lu instructions (peephole %lu, folding %lu, "
+         "unreachable %lu), threaded %lu jumps\n",
+         removed, size, stats.peephole, stats.folded, stats.unreachable,
+         stats.threaded);
+}
+
+bool assemble_layout(emitter_t *emitter, const char *name)
+{
+  size_t size       = emitter->program.used;
+  u64 *block_counts = calloc(size + 1, sizeof(*block_counts));
+  u64 *jump_counts  = calloc(size + 1, sizeof(*jump_counts));
+  FILE *fp          = fopen(name, "rb");
+  bool read = fp && profile_read(fp, size, block_counts, jump_counts);
+  if (!fp)
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET "]: Could not read file `%s`: %s\n",
+            name, strerror(errno));
+  else if (!read)
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET
+            "]: `%s` is not a profile of this program (%lu instructions)\n",
+            name, size);
+  if (fp)
+    fclose(fp);
+
+  if (read)
+  {
+    optimiser_layout_t stats = {0};
+    optimiser_layout(emitter, block_counts, jump_counts, &stats);
+    printf("[" TERM_CYAN "LAYOUT" TERM_RESET
+           "]: Taken jumps %lu -> %lu (estimated), deleted %lu jumps, "
+           "inserted %lu, placed %lu cold blocks last\n",
+           stats.taken_before, stats.taken_after, stats.deleted,
+           stats.inserted, stats.cold);
+  }
+  free(jump_counts);
+  free(block_counts);
+  return read;
 }
 
 int main(int argc, char *argv[])
 {
-  if (argc < 2)
+  bool streaming = false, pipelined = false, compile_only = false,
+       optimise = false;
+  size_t jobs    = parallel_jobs();
+  const char *cache = NULL, *layout = NULL;
+  int args       = 1;
+  for (; args < argc; ++args)
+  {
+    if (strcmp(argv[args], "-c") == 0)
+      compile_only = true;
+    else if (strcmp(argv[args], "-O") == 0)
+      optimise = true;
+    else if (strcmp(argv[args], "--layout") == 0 && args + 1 < argc)
+      layout = argv[++args];
+    else if (strcmp(argv[args], "--stream") == 0)
+      streaming = true;
+    else if (strcmp(argv[args], "--jobs") == 0 && args + 1 < argc)
+    {
+      // Counts above PARALLEL_MAX_JOBS are capped by parallel_assemble
+      char *end = NULL;
+      ++args;
+      jobs = strtoull(argv[args], &end, 10);
+      if (!isdigit(argv[args][0]) || *end != '\0' || jobs == 0)
+      {
+        usage(stderr);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[args], "--pipeline") == 0)
+      pipelined = true;
+    else if (strcmp(argv[args], "--cache") == 0 && args + 1 < argc)
+      cache = argv[++args];
+    else
+      break;
+  }
+
+  if (argc - args < 1)
   {
     usage(stderr);
     return 0;
   }
+  // Objects aren't optimised or laid out until they're linked
+  else if (compile_only && (optimise || layout))
+  {
+    usage(stderr);
+    return 1;
+  }
 
   bool generated_output = false;
-  const char *in_name   = argv[1];
+  const char *in_name   = argv[args];
   char *out_name        = NULL;
+  bool from_stdin       = strcmp(in_name, "-") == 0;
+  streaming             = streaming || from_stdin;
+  // Objects, optimised and laid out programs need the emitter's
+  // relocations
+  bool sequential = compile_only || optimise || layout;
 
-  if (argc > 2)
-    out_name = argv[2];
+  if (argc - args > 1)
+    out_name = argv[args + 1];
+  else if (from_stdin)
+  {
+    usage(stderr);
+    return 1;
+  }
   else
   {
     generated_output = true;
     size_t name_size = strlen(in_name);
     out_name         = calloc(name_size + 1, sizeof(*out_name));
-    gen_output_filename(in_name, name_size, out_name);
+    gen_output_filename(in_name, name_size, out_name,
+                        compile_only ? ".obj" : ".out");
   }
 
   int ret            = 0;
@@ -56,8 +180,9 @@ int main(int argc, char *argv[])
   stream_t stream    = {0};
   vm_t vm            = {0};
   op_t *instructions = NULL;
+  emitter_t emitter  = {0};
 
-  FILE *fp = fopen(in_name, "rb");
+  FILE *fp = from_stdin ? stdin : fopen(in_name, "rb");
   if (!fp)
   {
     fprintf(stderr,
@@ -68,29 +193,90 @@ int main(int argc, char *argv[])
     goto end;
   }
 
-  // Read file into memory
-  buffer = buffer_read_file(in_name, fp);
-  fclose(fp);
+  instructions          = NULL;
+  u64 instructions_size = 0;
+  perr_t err            = PERR_OK;
 
-  // Tokenise buffer
-  lerr_t lerr = tokenise_buffer(&stream, &buffer);
-  if (lerr != LERR_OK)
+  if (streaming)
+    // Tokens are lexed as parse_stream asks for them
+    stream_init_file(&stream, from_stdin ? "<stdin>" : in_name, fp);
+  else
   {
-    char *reason = lerr_generate(lerr, &buffer);
+    // Read file into memory
+    buffer = buffer_read_file(in_name, fp);
+    fclose(fp);
+
+    cache_stats_t stats = {0};
+    // Like parallel assembly, errors are left to the sequential path
+    if (!sequential && cache &&
+        cache_assemble(&buffer, cache, &instructions, &instructions_size,
+                       &stats))
+    {
+#if VERBOSE == 1
+      printf("[" TERM_CYAN "ASSEMBLER" TERM_RESET
+             "]: Reused %lu of %lu regions from `%s`\n",
+             stats.reused, stats.regions, cache);
+#endif
+      goto write;
+    }
+    else if (!sequential && pipelined)
+    {
+      // Errors are reported as if streaming, below
+      pipeline_stats_t stats[NUMBER_OF_PIPELINE_STAGES] = {0};
+      err = pipeline_assemble(&buffer, &stream, &instructions,
+                              &instructions_size, stats);
+      printf("[" TERM_CYAN "PIPELINE" TERM_RESET "]: `%s`\n", in_name);
+      pipeline_print_stats(stats, stdout);
+    }
+    // Large files are assembled in pieces; if that fails for any reason
+    // the sequential path below finds and reports the error
+    else if (!sequential &&
+             parallel_assemble(&buffer, jobs, &instructions,
+                               &instructions_size))
+      goto write;
+
+    if (sequential || !pipelined)
+    {
+      // Tokenise buffer
+      lerr_t lerr = tokenise_buffer(&stream, &buffer);
+      if (lerr != LERR_OK)
+      {
+        char *reason = lerr_generate(lerr, &buffer);
+        fprintf(stderr, "%s\n", reason);
+        free(reason);
+        ret = 255 - lerr;
+        goto end;
+      }
+    }
+  }
+
+  // Attempt to parse buffer, unless the pipeline already has
+  if (sequential)
+  {
+    emitter_init(&emitter);
+    err = stream_at_end(&stream) ? PERR_EOF : parse_emit(&stream, &emitter);
+    // Labels left unresolved in an object are imports, for the linker
+    // to find
+    if (compile_only)
+      emitter_resolve(&emitter);
+    else if (err == PERR_OK)
+      err = emitter_finish(&emitter, &stream);
+  }
+  else if (streaming || !pipelined)
+    err = parse_stream(&stream, &instructions, &instructions_size);
+  if (streaming && !from_stdin)
+    fclose(fp);
+  // A lexer error ends a streaming (or pipelined) lexer early, which
+  // the parser may not notice
+  if (stream.lerr != LERR_OK)
+  {
+    char *reason = stream_lerr_generate(&stream);
     fprintf(stderr, "%s\n", reason);
     free(reason);
-    ret = 255 - lerr;
+    ret = 255 - stream.lerr;
     goto end;
   }
-  free(buffer.data);
-  buffer.data = NULL;
-
-  instructions          = NULL;
-  u64 instructions_size = 0;
-
-  // Attempt to parse buffer
-  perr_t err = parse_stream(&stream, &instructions, &instructions_size);
-  if (err != PERR_OK)
+  else if (err != PERR_OK)
   {
     char *reason = perr_generate(err, &stream);
     fprintf(stderr, "%s\n", reason);
@@ -98,8 +284,46 @@ int main(int argc, char *argv[])
     ret = 255 - err;
     goto end;
   }
+  if (compile_only)
+  {
+    // Imported names are views into the stream, so write them first
+    fp = fopen(out_name, "wb");
+    if (!fp)
+    {
+      fprintf(stderr,
+              "[" TERM_RED "ERROR" TERM_RESET
+              "]: Could not open file `%s`: %s\n",
+              out_name, strerror(errno));
+      ret = 1;
+      goto end;
+    }
+    object_write(&emitter, fp);
+    fclose(fp);
+    goto end;
+  }
+  else if (sequential)
+  {
+    // Profile addresses are of the program before any optimisation
+    if (layout && !assemble_layout(&emitter, layout))
+    {
+      ret = 1;
+      goto end;
+    }
+    if (optimise)
+      assemble_optimise(&emitter);
+    // The program now belongs to us
+    instructions      = emitter.program.data;
+    instructions_size = emitter.program.used;
+    emitter.program   = (darr_t){0};
+  }
+
+  // Tokens are views into the buffer, so it must outlive parsing
   stream_free(&stream);
 
+write:
+  free(buffer.data);
+  buffer.data = NULL;
+
   vm_copy_program(&vm, instructions, instructions_size);
   free(instructions);
   instructions = NULL;
@@ -130,9 +354,10 @@ end:
     free(buffer.data);
   if (instructions)
     free(instructions);
-  if (stream.tokens)
-    stream_free(&stream);
+  stream_free(&stream);
+  emitter_free(&emitter);
   if (generated_output)
     free(out_name);
+  vm_free(&vm);
   return ret;
 }
@@ -0,0 +1,171 @@
+/* cache.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Incremental reassembly through a cache of source regions
+ */
+
+#include "./cache.h"
+
+#include <string.h>
+
+// Size of the region starting at start
+size_t cache_region_size(buffer_t *buffer, size_t start)
+{
+  const char *data = buffer->data;
+  size_t end       = start + CACHE_MIN_REGION;
+  // Same care for character literals as parallel_chunk_size
+  for (; end < buffer->available; ++end)
+    if (data[end - 1] == '\n' && data[end - 2] != '\'' &&
+        buffer->available - end > 6 && memcmp(data + end, "label", 5) == 0 &&
+        (data[end + 5] == ' ' || data[end + 5] == '\t'))
+      break;
+  return MIN(end, buffer->available) - start;
+}
+
+// Units in the cache file, each with an emitter allocated on the heap,
+// indexed by their text.  Returns false if the file is unusable.
+bool cache_read(const char *name, darr_t *units, htab_t *index)
+{
+  FILE *fp = fopen(name, "rb");
+  if (!fp)
+    return false;
+  buffer_t buffer = buffer_read_file(name, fp);
+  fclose(fp);
+
+  const size_t magic = sizeof(CACHE_MAGIC) - 1;
+  word version = 0, revision = 0, count = 0;
+  bool ok = buffer_space_left(buffer) > magic &&
+            memcmp(buffer.data, CACHE_MAGIC, magic) == 0;
+  buffer.cur += magic;
+  ok = ok && emitter_read_word(&buffer, &version) &&
+       version == CACHE_VERSION && emitter_read_word(&buffer, &revision) &&
+       revision == PARSER_REVISION && emitter_read_word(&buffer, &count);
+  for (word i = 0; ok && i < count; ++i)
+  {
+    cache_unit_t unit = {.emitter = malloc(sizeof(emitter_t))};
+    ok = emitter_read_word(&buffer, &unit.size) &&
+         unit.size <= buffer_space_left(buffer);
+    if (ok)
+    {
+      // The index keeps its own copy of the text
+      unit.text = buffer.data + buffer.cur;
+      buffer.cur += unit.size;
+    }
+    ok = ok && emitter_read(unit.emitter, &buffer);
+    if (!ok)
+    {
+      free(unit.emitter);
+      break;
+    }
+    DARR_APP(units, cache_unit_t, unit);
+    // The same region may appear more than once, any copy will do.
+    // Keys are compared in full, so only identical text is reused.
+    htab_insert(index, unit.text, unit.size, units->used - 1);
+  }
+  free(buffer.data);
+  return ok;
+}
+
+bool cache_write(const char *name, cache_unit_t *units, size_t count)
+{
+  FILE *fp = fopen(name, "wb");
+  if (!fp)
+    return false;
+  word version = CACHE_VERSION, revision = PARSER_REVISION, size = count;
+  fwrite(CACHE_MAGIC, 1, sizeof(CACHE_MAGIC) - 1, fp);
+  fwrite(&version, sizeof(version), 1, fp);
+  fwrite(&revision, sizeof(revision), 1, fp);
+  fwrite(&size, sizeof(size), 1, fp);
+  for (size_t i = 0; i < count; ++i)
+  {
+    fwrite(&units[i].size, sizeof(units[i].size), 1, fp);
+    fwrite(units[i].text, 1, units[i].size, fp);
+    emitter_write(units[i].emitter, fp);
+  }
+  return fclose(fp) == 0;
+}
+
+void cache_free_units(darr_t *units)
+{
+  for (size_t i = 0; i < units->used; ++i)
+  {
+    cache_unit_t unit = DARR_MEMBER(units, cache_unit_t, i);
+    emitter_free(unit.emitter);
+    free(unit.emitter);
+  }
+  darr_free(units);
+}
+
+bool cache_assemble(buffer_t *buffer, const char *cache_name,
+                    op_t **instructions, u64 *instructions_size,
+                    cache_stats_t *stats)
+{
+  darr_t cached = {0}, fresh = {0}, regions = {0};
+  htab_t index  = {0};
+  darr_init(&cached, DARR_INITAL_SIZE, sizeof(cache_unit_t));
+  darr_init(&fresh, DARR_INITAL_SIZE, sizeof(cache_unit_t));
+  darr_init(&regions, DARR_INITAL_SIZE, sizeof(cache_unit_t));
+  htab_init(&index, HTAB_INITIAL_SIZE);
+  if (!cache_read(cache_name, &cached, &index))
+  {
+    // Don't trust any of a cache which is partly broken
+    cache_free_units(&cached);
+    darr_init(&cached, DARR_INITAL_SIZE, sizeof(cache_unit_t));
+    htab_free(&index);
+    htab_init(&index, HTAB_INITIAL_SIZE);
+  }
+
+  *stats  = (cache_stats_t){0};
+  bool ok = true;
+  for (size_t start = 0; ok && start < buffer->available;)
+  {
+    size_t size       = cache_region_size(buffer, start);
+    cache_unit_t unit = {buffer->data + start, size, NULL};
+    word found        = 0;
+    if (htab_get(&index, unit.text, unit.size, &found))
+    {
+      unit.emitter = DARR_MEMBER(&cached, cache_unit_t, found).emitter;
+      ++stats->reused;
+    }
+    else
+    {
+      buffer_t view = {.name      = buffer->name,
+                       .data      = buffer->data + start,
+                       .available = size};
+      unit.emitter  = malloc(sizeof(emitter_t));
+      ok            = emitter_assemble(unit.emitter, &view);
+      DARR_APP(&fresh, cache_unit_t, unit);
+    }
+    DARR_APP(&regions, cache_unit_t, unit);
+    ++stats->regions;
+    start += size;
+  }
+
+  darr_t program = {0};
+  if (ok)
+  {
+    // emitter_link wants the emitters themselves, in order
+    emitter_t *emitters = calloc(MAX(regions.used, 1), sizeof(*emitters));
+    for (size_t i = 0; i < regions.used; ++i)
+      emitters[i] = *DARR_MEMBER(&regions, cache_unit_t, i).emitter;
+    ok = regions.used > 0 &&
+         emitter_link(emitters, regions.used, &program, NULL) == PERR_OK;
+    free(emitters);
+  }
+
+  if (ok)
+  {
+    // A cache which can't be written only costs the next run, and one
+    // holding exactly these regions needn't be written at all
+    if (fresh.used > 0 || cached.used != regions.used)
+      cache_write(cache_name, regions.data, regions.used);
+    *instructions      = program.data;
+    *instructions_size = program.used;
+  }
+
+  darr_free(&regions);
+  cache_free_units(&fresh);
+  cache_free_units(&cached);
+  htab_free(&index);
+  return ok;
+}
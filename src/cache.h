@@ -0,0 +1,42 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "./lib.h"
+#include "./op.h"
+#include "./parser.h"
+
+/* Incremental reassembly: a source is split into regions which start at
+ * a top-level `label` and are at least CACHE_MIN_REGION bytes, and each
+ * region is assembled into its own emitter, keyed by its text.  The
+ * emitters and their text are kept in a cache file between runs, so
+ * only regions whose text changed are lexed and parsed again; the rest
+ * are read back and everything is relinked (see emitter_link).  A
+ * cache from another version of the format or of the parser (see
+ * PARSER_REVISION) is ignored.
+ *
+ * Boundaries only depend on the text since the previous boundary, so
+ * an edit moves at most the boundaries just after it.  As with
+ * parallel assembly, any failure means the caller should assemble the
+ * source as a whole instead, which also reports errors properly. */
+#define CACHE_MIN_REGION 4096
+#define CACHE_MAGIC      "SVMCACHE"
+#define CACHE_VERSION    2
+
+typedef struct
+{
+  const char *text;
+  word size;
+  emitter_t *emitter;
+} cache_unit_t;
+
+typedef struct
+{
+  size_t regions, reused;
+} cache_stats_t;
+
+// Returns false if the buffer should be assembled without the cache.
+// The cache file (which need not exist) is rewritten on success.
+bool cache_assemble(buffer_t *, const char *cache_name, op_t **instructions,
+                    u64 *instructions_size, cache_stats_t *);
+
+#endif
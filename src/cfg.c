@@ -0,0 +1,432 @@
+/* cfg.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Control flow graphs, dominators and loops of programs
+ */
+
+#include "./cfg.h"
+
+#include <string.h>
+
+// Whether the instruction at address ends its block
+bool cfg_ends_block(op_t op)
+{
+  return op.opcode == OP_JUMP || op.opcode == OP_HALT;
+}
+
+// Whether op holds the address of an instruction in the program
+bool cfg_address(op_t op, size_t size)
+{
+  return data_type(op.operand) == DATA_UINT && data_as_uint(op.operand) < size;
+}
+
+void cfg_find_blocks(cfg_t *cfg, const op_t *program, const bool *relocated)
+{
+  size_t size   = cfg->size_program;
+  bool *leader  = calloc(size + 1, sizeof(*leader));
+  bool *returns = calloc(size + 1, sizeof(*returns));
+  leader[0]     = true;
+  for (size_t i = 0; i < size; ++i)
+  {
+    op_t op = program[i];
+    if (cfg_ends_block(op))
+      leader[i + 1] = true;
+    if (op.opcode == OP_JUMP && cfg_address(op, size))
+      leader[data_as_uint(op.operand)] = true;
+    else if (op.opcode == OP_PUSH && (!relocated || relocated[i]) &&
+             cfg_address(op, size))
+    {
+      leader[data_as_uint(op.operand)]  = true;
+      returns[data_as_uint(op.operand)] = true;
+    }
+  }
+
+  cfg->blocks = 0;
+  for (size_t i = 0; i < size; ++i)
+    if (leader[i])
+      ++cfg->blocks;
+
+  cfg->block_of = calloc(size + 1, sizeof(*cfg->block_of));
+  cfg->leaders  = calloc(cfg->blocks + 1, sizeof(*cfg->leaders));
+  cfg->returns  = calloc(cfg->blocks + 1, sizeof(*cfg->returns));
+  cfg->dynamic  = calloc(cfg->blocks + 1, sizeof(*cfg->dynamic));
+  for (size_t i = 0, block = 0; i < size; ++i)
+  {
+    if (leader[i])
+    {
+      cfg->returns[block]   = returns[i];
+      cfg->leaders[block++] = i;
+    }
+    cfg->block_of[i] = block - 1;
+  }
+  cfg->leaders[cfg->blocks] = size;
+
+  free(returns);
+  free(leader);
+}
+
+void cfg_find_edges(cfg_t *cfg, const op_t *program)
+{
+  size_t blocks   = cfg->blocks;
+  cfg->succ_start = calloc(blocks + 1, sizeof(*cfg->succ_start));
+  cfg->pred_start = calloc(blocks + 1, sizeof(*cfg->pred_start));
+  // No instruction branches, so every block has at most one successor
+  cfg->succs = calloc(blocks + 1, sizeof(*cfg->succs));
+  cfg->preds = calloc(blocks + 1, sizeof(*cfg->preds));
+
+  size_t edges = 0;
+  for (size_t b = 0; b < blocks; ++b)
+  {
+    cfg->succ_start[b] = edges;
+    op_t last          = program[cfg->leaders[b + 1] - 1];
+    if (last.opcode == OP_JUMP && cfg_address(last, cfg->size_program))
+      cfg->succs[edges++] = cfg->block_of[data_as_uint(last.operand)];
+    else if (last.opcode == OP_JUMP)
+      cfg->dynamic[b] = data_type(last.operand) == DATA_NIL;
+    else if (last.opcode != OP_HALT && b + 1 < blocks)
+      cfg->succs[edges++] = b + 1;
+  }
+  cfg->succ_start[blocks] = edges;
+
+  // Predecessors by counting sort on the successors
+  size_t *filled = calloc(blocks + 1, sizeof(*filled));
+  for (size_t i = 0; i < edges; ++i)
+    ++cfg->pred_start[cfg->succs[i] + 1];
+  for (size_t b = 0; b < blocks; ++b)
+    cfg->pred_start[b + 1] += cfg->pred_start[b];
+  for (size_t b = 0; b < blocks; ++b)
+    for (size_t i = cfg->succ_start[b]; i < cfg->succ_start[b + 1]; ++i)
+    {
+      size_t s = cfg->succs[i];
+      cfg->preds[cfg->pred_start[s] + filled[s]++] = b;
+    }
+  free(filled);
+}
+
+// Whether block b is an entry point
+bool cfg_is_entry(cfg_t *cfg, size_t b)
+{
+  return b == 0 || cfg->returns[b];
+}
+
+void cfg_find_order(cfg_t *cfg)
+{
+  size_t blocks = cfg->blocks;
+  size_t *stack = calloc(blocks + 1, sizeof(*stack)), stack_size = 0;
+  size_t *next  = calloc(blocks + 1, sizeof(*next));
+  bool *visited = calloc(blocks + 1, sizeof(*visited));
+  size_t *post  = calloc(blocks + 1, sizeof(*post)), posts = 0;
+
+  // Depth first from each entry point in turn, without recursion as
+  // there may be millions of blocks
+  for (size_t root = 0; root < blocks; ++root)
+  {
+    if (!cfg_is_entry(cfg, root) || visited[root])
+      continue;
+    visited[root]       = true;
+    next[root]          = cfg->succ_start[root];
+    stack[stack_size++] = root;
+    while (stack_size > 0)
+    {
+      size_t b = stack[stack_size - 1];
+      if (next[b] == cfg->succ_start[b + 1])
+      {
+        post[posts++] = b;
+        --stack_size;
+        continue;
+      }
+      size_t s = cfg->succs[next[b]++];
+      if (!visited[s])
+      {
+        visited[s]          = true;
+        next[s]             = cfg->succ_start[s];
+        stack[stack_size++] = s;
+      }
+    }
+  }
+
+  cfg->reachable = posts;
+  cfg->order     = calloc(blocks + 1, sizeof(*cfg->order));
+  for (size_t i = 0; i < posts; ++i)
+    cfg->order[i] = post[posts - 1 - i];
+
+  free(post);
+  free(visited);
+  free(next);
+  free(stack);
+}
+
+size_t cfg_intersect(size_t *idom, size_t *rank, size_t a, size_t b)
+{
+  while (a != b)
+  {
+    while (rank[a] > rank[b])
+      a = idom[a];
+    while (rank[b] > rank[a])
+      b = idom[b];
+  }
+  return a;
+}
+
+/* Dominators by Cooper, Harvey and Kennedy's iterative algorithm, over
+ * the blocks in reverse postorder.  Entry points hang off a virtual
+ * root (numbered blocks) which comes before every block. */
+void cfg_find_dominators(cfg_t *cfg)
+{
+  size_t blocks = cfg->blocks, root = blocks;
+  size_t *rank  = calloc(blocks + 1, sizeof(*rank));
+  cfg->idom     = calloc(blocks + 1, sizeof(*cfg->idom));
+  for (size_t b = 0; b < blocks; ++b)
+    cfg->idom[b] = CFG_NONE;
+  for (size_t i = 0; i < cfg->reachable; ++i)
+    rank[cfg->order[i]] = i + 1;
+  cfg->idom[root] = root;
+
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (size_t i = 0; i < cfg->reachable; ++i)
+    {
+      size_t b    = cfg->order[i];
+      size_t idom = cfg_is_entry(cfg, b) ? root : CFG_NONE;
+      for (size_t j = cfg->pred_start[b]; j < cfg->pred_start[b + 1]; ++j)
+      {
+        size_t p = cfg->preds[j];
+        if (cfg->idom[p] == CFG_NONE)
+          continue;
+        idom = idom == CFG_NONE ? p : cfg_intersect(cfg->idom, rank, p, idom);
+      }
+      if (cfg->idom[b] != idom)
+      {
+        cfg->idom[b] = idom;
+        changed      = true;
+      }
+    }
+  }
+
+  for (size_t b = 0; b < blocks; ++b)
+    if (cfg->idom[b] == root)
+      cfg->idom[b] = b;
+  free(rank);
+}
+
+// Number the dominator tree so cfg_dominates is constant time
+void cfg_number_dominators(cfg_t *cfg)
+{
+  size_t blocks  = cfg->blocks;
+  size_t *start  = calloc(blocks + 2, sizeof(*start));
+  size_t *filled = calloc(blocks + 1, sizeof(*filled));
+  size_t *kids   = calloc(blocks + 1, sizeof(*kids));
+  size_t *stack  = calloc(blocks + 1, sizeof(*stack)), stack_size = 0;
+  size_t *next   = calloc(blocks + 1, sizeof(*next));
+  size_t pre     = 0, post = 0;
+  cfg->dom_pre   = calloc(blocks + 1, sizeof(*cfg->dom_pre));
+  cfg->dom_post  = calloc(blocks + 1, sizeof(*cfg->dom_post));
+
+  // Children of each block in the dominator tree
+  for (size_t b = 0; b < blocks; ++b)
+    if (cfg->idom[b] != CFG_NONE && cfg->idom[b] != b)
+      ++start[cfg->idom[b] + 1];
+  for (size_t b = 0; b < blocks; ++b)
+    start[b + 1] += start[b];
+  for (size_t b = 0; b < blocks; ++b)
+    if (cfg->idom[b] != CFG_NONE && cfg->idom[b] != b)
+      kids[start[cfg->idom[b]] + filled[cfg->idom[b]]++] = b;
+
+  for (size_t b = 0; b < blocks; ++b)
+  {
+    cfg->dom_pre[b]  = CFG_NONE;
+    cfg->dom_post[b] = CFG_NONE;
+  }
+  for (size_t root = 0; root < blocks; ++root)
+  {
+    if (cfg->idom[root] != root)
+      continue;
+    cfg->dom_pre[root]  = pre++;
+    next[root]          = start[root];
+    stack[stack_size++] = root;
+    while (stack_size > 0)
+    {
+      size_t b = stack[stack_size - 1];
+      if (next[b] == start[b + 1])
+      {
+        cfg->dom_post[b] = post++;
+        --stack_size;
+        continue;
+      }
+      size_t kid          = kids[next[b]++];
+      cfg->dom_pre[kid]   = pre++;
+      next[kid]           = start[kid];
+      stack[stack_size++] = kid;
+    }
+  }
+
+  free(next);
+  free(stack);
+  free(kids);
+  free(filled);
+  free(start);
+}
+
+bool cfg_dominates(cfg_t *cfg, size_t a, size_t b)
+{
+  if (cfg->dom_pre[a] == CFG_NONE || cfg->dom_pre[b] == CFG_NONE)
+    return false;
+  return cfg->dom_pre[a] <= cfg->dom_pre[b] &&
+         cfg->dom_post[b] <= cfg->dom_post[a];
+}
+
+size_t cfg_find_root(size_t *parent, size_t x)
+{
+  size_t root = x;
+  while (parent[root] != root)
+    root = parent[root];
+  // Path compression
+  while (parent[x] != root)
+  {
+    size_t next = parent[x];
+    parent[x]   = root;
+    x           = next;
+  }
+  return root;
+}
+
+/* Natural loops: a back edge goes from a block to one dominating it,
+ * its loop header.  Headers are visited innermost first (backwards in
+ * reverse postorder), each walking back from its back edges to collect
+ * its body; loops already found are collapsed into their header by a
+ * union find, so every block is walked past a bounded number of times.
+ * Retreating edges to a block which doesn't dominate them (irreducible
+ * flow) don't make loops. */
+void cfg_find_loops(cfg_t *cfg)
+{
+  size_t blocks    = cfg->blocks;
+  size_t *parent   = calloc(blocks + 1, sizeof(*parent));
+  size_t *mark     = calloc(blocks + 1, sizeof(*mark));
+  size_t *work     = calloc(blocks + cfg->pred_start[blocks] + 1,
+                            sizeof(*work));
+  cfg->loop_header = calloc(blocks + 1, sizeof(*cfg->loop_header));
+  cfg->loop_parent = calloc(blocks + 1, sizeof(*cfg->loop_parent));
+  cfg->loop_depth  = calloc(blocks + 1, sizeof(*cfg->loop_depth));
+  for (size_t b = 0; b < blocks; ++b)
+  {
+    parent[b]           = b;
+    mark[b]             = CFG_NONE;
+    cfg->loop_header[b] = CFG_NONE;
+    cfg->loop_parent[b] = CFG_NONE;
+  }
+
+  for (size_t i = cfg->reachable; i-- > 0;)
+  {
+    size_t header = cfg->order[i], work_size = 0;
+    for (size_t j = cfg->pred_start[header]; j < cfg->pred_start[header + 1];
+         ++j)
+      if (cfg_dominates(cfg, header, cfg->preds[j]))
+        work[work_size++] = cfg->preds[j];
+    if (work_size == 0)
+      continue;
+
+    cfg->loop_header[header] = header;
+    while (work_size > 0)
+    {
+      size_t b = cfg_find_root(parent, work[--work_size]);
+      if (b == header || mark[b] == header)
+        continue;
+      mark[b]   = header;
+      parent[b] = header;
+      // b is either in no loop yet or the header of an inner loop
+      if (cfg->loop_header[b] == CFG_NONE)
+        cfg->loop_header[b] = header;
+      else
+        cfg->loop_parent[b] = header;
+      for (size_t j = cfg->pred_start[b]; j < cfg->pred_start[b + 1]; ++j)
+        if (cfg->idom[cfg->preds[j]] != CFG_NONE)
+          work[work_size++] = cfg->preds[j];
+    }
+  }
+
+  // Headers come before their loops in reverse postorder
+  for (size_t i = 0; i < cfg->reachable; ++i)
+  {
+    size_t b = cfg->order[i], header = cfg->loop_header[b];
+    if (header == CFG_NONE)
+      continue;
+    else if (header != b)
+      cfg->loop_depth[b] = cfg->loop_depth[header];
+    else if (cfg->loop_parent[b] == CFG_NONE)
+      cfg->loop_depth[b] = 1;
+    else
+      cfg->loop_depth[b] = cfg->loop_depth[cfg->loop_parent[b]] + 1;
+  }
+
+  free(work);
+  free(mark);
+  free(parent);
+}
+
+void cfg_init(cfg_t *cfg, const op_t *program, size_t size,
+              const bool *relocated)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->size_program = size;
+  cfg_find_blocks(cfg, program, relocated);
+  cfg_find_edges(cfg, program);
+  cfg_find_order(cfg);
+  cfg_find_dominators(cfg);
+  cfg_number_dominators(cfg);
+  cfg_find_loops(cfg);
+}
+
+void cfg_free(cfg_t *cfg)
+{
+  free(cfg->block_of);
+  free(cfg->leaders);
+  free(cfg->succ_start);
+  free(cfg->succs);
+  free(cfg->pred_start);
+  free(cfg->preds);
+  free(cfg->returns);
+  free(cfg->dynamic);
+  free(cfg->order);
+  free(cfg->idom);
+  free(cfg->dom_pre);
+  free(cfg->dom_post);
+  free(cfg->loop_header);
+  free(cfg->loop_parent);
+  free(cfg->loop_depth);
+  *cfg = (cfg_t){0};
+}
+
+void cfg_write_dot(cfg_t *cfg, FILE *fp)
+{
+  bool dynamic = false;
+  fprintf(fp, "digraph cfg {\n  node [shape=box];\n");
+  for (size_t b = 0; b < cfg->blocks; ++b)
+  {
+    fprintf(fp, "  b%lu [label=\"b%lu: %" PRIu64 "..%" PRIu64, b, b,
+            cfg->leaders[b], cfg->leaders[b + 1] - 1);
+    if (cfg->loop_header[b] != CFG_NONE)
+      fprintf(fp, "\\nloop b%lu, depth %lu", cfg->loop_header[b],
+              cfg->loop_depth[b]);
+    fprintf(fp, "\"%s%s];\n", cfg->returns[b] ? ", peripheries=2" : "",
+            cfg->idom[b] == CFG_NONE ? ", style=dotted" : "");
+    dynamic = dynamic || cfg->dynamic[b];
+  }
+
+  for (size_t b = 0; b < cfg->blocks; ++b)
+  {
+    for (size_t i = cfg->succ_start[b]; i < cfg->succ_start[b + 1]; ++i)
+      fprintf(fp, "  b%lu -> b%lu;\n", b, cfg->succs[i]);
+    if (cfg->dynamic[b])
+      fprintf(fp, "  b%lu -> dynamic [style=dashed];\n", b);
+  }
+
+  if (dynamic)
+  {
+    fprintf(fp, "  dynamic [shape=diamond, label=\"jmp *\"];\n");
+    for (size_t b = 0; b < cfg->blocks; ++b)
+      if (cfg->returns[b])
+        fprintf(fp, "  dynamic -> b%lu [style=dashed];\n", b);
+  }
+  fprintf(fp, "}\n");
+}
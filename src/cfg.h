@@ -0,0 +1,72 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include "./lib.h"
+#include "./op.h"
+
+#include <stdio.h>
+
+/* Control flow graph of a program: its basic blocks, the edges between
+ * them, dominators and loops, all in arrays indexed by block number
+ * and built in time linear in the size of the program (near enough).
+ *
+ * Leaders are the entry point, static jump targets, the instruction
+ * after every jump or halt and `push *N` return sites.  A `jmp *` may
+ * go to any return site, so rather than an edge from every `jmp *` to
+ * every return site, return sites are extra entry points alongside the
+ * first block: dominators and loops are then exact within the code
+ * between them, and never claimed across a `jmp *`. */
+
+#define CFG_NONE ((size_t)-1)
+
+typedef struct
+{
+  size_t size_program, blocks;
+
+  // Block of each instruction (size_program members)
+  size_t *block_of;
+  // Address of the leader of each block, then size_program
+  word *leaders;
+
+  // Successors of block b are succs[succ_start[b]] up to (but not
+  // including) succs[succ_start[b + 1]], and likewise for predecessors
+  size_t *succ_start, *succs;
+  size_t *pred_start, *preds;
+  // Whether each block is a return site, or ends in `jmp *`
+  bool *returns, *dynamic;
+
+  // Blocks reachable from an entry point, in reverse postorder
+  size_t *order, reachable;
+  // Immediate dominator of each block: entry points are their own and
+  // unreachable blocks have CFG_NONE
+  size_t *idom;
+  // Preorder and postorder number of each block in the dominator tree,
+  // for cfg_dominates
+  size_t *dom_pre, *dom_post;
+
+  // Header of the innermost loop each block is in (CFG_NONE if none),
+  // where a loop header is its own
+  size_t *loop_header;
+  // Header of the loop enclosing each loop header's loop
+  size_t *loop_parent;
+  // Number of loops each block is in
+  size_t *loop_depth;
+} cfg_t;
+
+/* Build the graph of a program.  relocated says which pushes are `push
+ * *N` (one flag per instruction, see optimiser_relocated); if NULL,
+ * every push of a uint which could be an address is treated as one, as
+ * for bytecode read back from a file. */
+void cfg_init(cfg_t *, const op_t *program, size_t size,
+              const bool *relocated);
+void cfg_free(cfg_t *);
+
+// Whether every path from an entry point to block b goes through block a
+bool cfg_dominates(cfg_t *, size_t a, size_t b);
+
+/* Graphviz DOT: a box per block with its addresses and loop, solid
+ * edges for fall through and static jumps, and dashed edges through a
+ * node for `jmp *` to the return sites. */
+void cfg_write_dot(cfg_t *, FILE *);
+
+#endif
@@ -0,0 +1,162 @@
+/* counters.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Hardware performance counters
+ */
+
+// For syscall
+#define _DEFAULT_SOURCE
+
+#include "./counters.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *counter_as_cstr(counter_t counter)
+{
+  switch (counter)
+  {
+  case COUNTER_CYCLES:
+    return "cycles";
+  case COUNTER_INSTRUCTIONS:
+    return "instructions";
+  case COUNTER_BRANCH_MISSES:
+    return "branch_misses";
+  case COUNTER_L1I_MISSES:
+    return "l1i_misses";
+  case NUMBER_OF_COUNTERS:
+  default:
+    return "";
+  }
+}
+
+#ifdef __linux__
+int counter_open_event(counter_t counter)
+{
+  struct perf_event_attr attr = {0};
+  attr.size                   = sizeof(attr);
+  attr.disabled               = 1;
+  attr.exclude_kernel         = 1;
+  attr.exclude_hv             = 1;
+  switch (counter)
+  {
+  case COUNTER_CYCLES:
+    attr.type   = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case COUNTER_INSTRUCTIONS:
+    attr.type   = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case COUNTER_BRANCH_MISSES:
+    attr.type   = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    break;
+  case COUNTER_L1I_MISSES:
+    attr.type   = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_L1I |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    break;
+  case NUMBER_OF_COUNTERS:
+  default:
+    return -1;
+  }
+  // This process, any CPU, no group
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+bool counters_open(counters_t *counters)
+{
+  memset(counters, 0, sizeof(*counters));
+  for (size_t i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+#ifdef __linux__
+    counters->fds[i] = counter_open_event(i);
+#else
+    counters->fds[i] = -1;
+#endif
+    counters->available[i] = counters->fds[i] >= 0;
+  }
+  return counters_any(counters);
+}
+
+void counters_close(counters_t *counters)
+{
+  for (size_t i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+#ifdef __linux__
+    if (counters->available[i])
+      close(counters->fds[i]);
+#endif
+    counters->available[i] = false;
+    counters->fds[i]       = -1;
+  }
+}
+
+bool counters_any(counters_t *counters)
+{
+  for (size_t i = 0; i < NUMBER_OF_COUNTERS; ++i)
+    if (counters->available[i])
+      return true;
+  return false;
+}
+
+void counters_start(counters_t *counters)
+{
+  for (size_t i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+    counters->values[i] = 0;
+#ifdef __linux__
+    if (counters->available[i])
+    {
+      ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+}
+
+void counters_stop(counters_t *counters)
+{
+  for (size_t i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+#ifdef __linux__
+    if (!counters->available[i])
+      continue;
+    ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    u64 value = 0;
+    if (read(counters->fds[i], &value, sizeof(value)) == sizeof(value))
+      counters->values[i] = value;
+#endif
+  }
+}
+
+void counters_print_json(counters_t *counters, u64 guest_instructions,
+                         u64 wall_ns, FILE *fp)
+{
+  fprintf(fp,
+          "{\"guest_instructions\": %" PRIu64 ", \"wall_ns\": %" PRIu64
+          ", \"ns_per_instruction\": %.3f",
+          guest_instructions, wall_ns,
+          (double)wall_ns / MAX(guest_instructions, 1));
+  for (size_t i = 0; i < NUMBER_OF_COUNTERS; ++i)
+  {
+    if (!counters->available[i])
+      continue;
+    double per_guest =
+        (double)counters->values[i] / MAX(guest_instructions, 1);
+    fprintf(fp, ", \"%s\": %" PRIu64 ", \"%s_per_instruction\": %.3f",
+            counter_as_cstr(i), counters->values[i], counter_as_cstr(i),
+            per_guest);
+  }
+  fprintf(fp, ", \"counters_available\": %s}\n",
+          counters_any(counters) ? "true" : "false");
+}
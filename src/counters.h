@@ -0,0 +1,45 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include "./lib.h"
+
+/* Hardware performance counters (through perf_event_open on Linux).
+ * Each counter is opened on its own so a kernel or machine that
+ * doesn't support one of them still gives us the rest; when none are
+ * available every counter reads as unavailable and callers should
+ * fall back to timing only. */
+
+typedef enum
+{
+  COUNTER_CYCLES = 0,
+  COUNTER_INSTRUCTIONS,
+  COUNTER_BRANCH_MISSES,
+  COUNTER_L1I_MISSES,
+
+  NUMBER_OF_COUNTERS,
+} counter_t;
+
+typedef struct
+{
+  int fds[NUMBER_OF_COUNTERS];
+  bool available[NUMBER_OF_COUNTERS];
+  u64 values[NUMBER_OF_COUNTERS];
+} counters_t;
+
+const char *counter_as_cstr(counter_t);
+
+// Returns true if at least one counter could be opened
+bool counters_open(counters_t *);
+void counters_close(counters_t *);
+bool counters_any(counters_t *);
+
+// Counting is scoped by start and stop, values holds the result
+void counters_start(counters_t *);
+void counters_stop(counters_t *);
+
+// JSON object of the wall time and every available counter, both total
+// and divided by the number of guest (VM) instructions
+void counters_print_json(counters_t *, u64 guest_instructions, u64 wall_ns,
+                         FILE *);
+
+#endif
@@ -4,33 +4,155 @@
  * Description: Bytecode interpreter
  */
 
+#include "./cfg.h"
+#include "./counters.h"
 #include "./lib.h"
 #include "./op.h"
 #include "./parser.h"
+#include "./profile.h"
 #include "./vm.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
 
+// Latencies of every run are kept to find percentiles, so bound them
+#define REPEAT_MAX 1000000
+
 void usage(FILE *fp)
 {
-  fputs("./interpreter.out [FILE]\n"
-        "\\tInterpret bytecode in FILE\n"
-        "\tFILE: File name for bytecode\n",
+  fputs("./interpreter.out [OPTIONS]... [FILE]\n"
+        "\tInterpret bytecode in FILE\n"
+        "\tFILE: File name for bytecode\n"
+        "\t--profile OUT: Write basic block and jump edge counts to OUT\n"
+        "\t--cfg OUT: Write the control flow graph, with loops, to OUT in "
+        "DOT format before running\n"
+        "\t--stats: Print runtime statistics as JSON to stderr\n"
+        "\t--counters: Print hardware performance counters as JSON to "
+        "stderr\n"
+        "\t--trace: Print every instruction to stderr before executing it\n"
+        "\t--repeat N: Verify the program then run it N (1 to 1000000)\n"
+        "\t\ttimes, discarding output, and report latency percentiles per\n"
+        "\t\trun\n",
         fp);
 }
 
+err_t trace_hook(vm_t *vm, op_t op, void *data)
+{
+  FILE *fp = data;
+  fprintf(fp, "[" TERM_CYAN "TRACE" TERM_RESET "]: %lu: ", vm->iptr);
+  op_print(op, fp);
+  fprintf(fp, " (sptr=%lu)\n", vm->sptr);
+  return ERR_OK;
+}
+
+int u64_cmp(const void *a, const void *b)
+{
+  u64 x = *(const u64 *)a, y = *(const u64 *)b;
+  return x < y ? -1 : x > y;
+}
+
+// Nearest rank percentile of sorted samples
+u64 percentile(u64 *sorted, size_t n, size_t p)
+{
+  size_t rank = (p * n + 99) / 100;
+  return sorted[rank ? rank - 1 : 0];
+}
+
+err_t repeat_execute(vm_t *vm, size_t repeat, u64 *retired, u64 *wall_ns)
+{
+  // Latency of a run shouldn't include the terminal
+  FILE *sink = fopen("/dev/null", "w");
+  if (!sink)
+    fprintf(stderr,
+            "[" TERM_RED "WARNING" TERM_RESET
+            "]: Could not open `/dev/null`, printing to stdout: %s\n",
+            strerror(errno));
+  vm->output = sink;
+
+  u64 *latencies = calloc(repeat, sizeof(*latencies));
+  err_t err      = ERR_OK;
+  size_t runs    = 0;
+  for (; runs < repeat && err == ERR_OK; ++runs)
+  {
+    vm_reset(vm);
+    err             = vm_execute_all(vm);
+    latencies[runs] = vm->stats.wall_ns;
+    *retired += vm->stats.retired;
+    *wall_ns += vm->stats.wall_ns;
+  }
+  vm->output = NULL;
+  if (sink)
+    fclose(sink);
+
+  qsort(latencies, runs, sizeof(*latencies), u64_cmp);
+  printf("[" TERM_CYAN "INTERPRETER" TERM_RESET "]: %lu runs (ns): min=%" PRIu64
+         " p50=%" PRIu64 " p90=%" PRIu64 " p99=%" PRIu64 " max=%" PRIu64 "\n",
+         runs, latencies[0], percentile(latencies, runs, 50),
+         percentile(latencies, runs, 90), percentile(latencies, runs, 99),
+         latencies[runs - 1]);
+  free(latencies);
+  return err;
+}
+
 int main(int argc, char *argv[])
 {
-  if (argc != 2)
+  vm_t vm                  = {0};
+  const char *file_name    = NULL;
+  const char *profile_name = NULL;
+  const char *cfg_name     = NULL;
+  bool print_stats         = false;
+  bool print_counters      = false;
+  size_t repeat            = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+      profile_name = argv[++i];
+    else if (strcmp(argv[i], "--cfg") == 0 && i + 1 < argc)
+      cfg_name = argv[++i];
+    else if (strcmp(argv[i], "--stats") == 0)
+      print_stats = true;
+    else if (strcmp(argv[i], "--counters") == 0)
+      print_counters = true;
+    else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+    {
+      // Anything but a positive number would quietly run once
+      char *end = NULL;
+      ++i;
+      repeat = strtoull(argv[i], &end, 10);
+      if (!isdigit(argv[i][0]) || *end != '\0' || repeat == 0 ||
+          repeat > REPEAT_MAX)
+      {
+        usage(stderr);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--trace") == 0)
+      vm_set_hook(&vm, trace_hook, stderr);
+    else if (!file_name && argv[i][0] != '-')
+      file_name = argv[i];
+    else
+    {
+      usage(stderr);
+      return 1;
+    }
+  }
+
+  if (!file_name)
   {
     usage(stderr);
     return 0;
   }
+  else if (repeat > 0 && profile_name)
+  {
+    fprintf(stderr, "[" TERM_RED "ERROR" TERM_RESET
+                    "]: --profile and --repeat can't be used together\n");
+    return 1;
+  }
 
-  vm_t vm               = {0};
-  const char *file_name = argv[1];
+  u64 load_started = time_now_ns();
 
   FILE *fp = fopen(file_name, "rb");
   if (!fp)
@@ -58,8 +180,50 @@ int main(int argc, char *argv[])
     char *message = err_generate(err_read, &buffer);
     fprintf(stderr, "%s (in reading `%s`)\n", message, file_name);
     free(message);
+    vm_free(&vm);
     return -1;
   }
+  u64 load_ns = time_now_ns() - load_started;
+
+  if (repeat > 0)
+  {
+    word at            = 0;
+    u64 verify_started = time_now_ns();
+    err_t err_verify   = vm_verify_program(&vm, &at);
+    u64 verify_ns      = time_now_ns() - verify_started;
+    if (err_verify != ERR_OK)
+    {
+      fprintf(stderr,
+              "[" TERM_RED "ERROR" TERM_RESET "]: %s at instruction %lu (in "
+              "verifying `%s`)\n",
+              err_as_cstr(err_verify), at, file_name);
+      vm_free(&vm);
+      return -1;
+    }
+    printf("[" TERM_CYAN "INTERPRETER" TERM_RESET "]: load=%" PRIu64
+           " ns, verify=%" PRIu64 " ns, %lu instructions\n",
+           load_ns, verify_ns, vm.size_program);
+  }
+
+  if (cfg_name)
+  {
+    FILE *cfg_fp = fopen(cfg_name, "w");
+    if (!cfg_fp)
+    {
+      fprintf(stderr,
+              "[" TERM_RED "ERROR" TERM_RESET
+              "]: Could not open file `%s`: %s\n",
+              cfg_name, strerror(errno));
+      vm_free(&vm);
+      return 1;
+    }
+    // Bytecode doesn't say which pushes are `push *N`, so any could be
+    cfg_t cfg = {0};
+    cfg_init(&cfg, vm.program, vm.size_program, NULL);
+    cfg_write_dot(&cfg, cfg_fp);
+    cfg_free(&cfg);
+    fclose(cfg_fp);
+  }
 
 #if VERBOSE == 1
   printf("[" TERM_CYAN "INTEPRETER" TERM_RESET
@@ -67,7 +231,53 @@ int main(int argc, char *argv[])
          vm.size_program);
 #endif
 
-  err_t err_exec = vm_execute_all(&vm);
+  counters_t counters = {0};
+  if (print_counters && !counters_open(&counters))
+    fprintf(stderr, "[" TERM_RED "WARNING" TERM_RESET
+                    "]: Hardware counters are unavailable, timing only\n");
+
+  err_t err_exec = ERR_OK;
+  u64 retired = 0, wall_ns = 0;
+  counters_start(&counters);
+  if (repeat > 0)
+    err_exec = repeat_execute(&vm, repeat, &retired, &wall_ns);
+  else if (profile_name)
+  {
+    FILE *profile_fp = fopen(profile_name, "w");
+    if (!profile_fp)
+    {
+      fprintf(stderr,
+              "[" TERM_RED "ERROR" TERM_RESET
+              "]: Could not open file `%s`: %s\n",
+              profile_name, strerror(errno));
+      counters_close(&counters);
+      vm_free(&vm);
+      return 1;
+    }
+    profile_t profile = {0};
+    profile_init(&profile, &vm);
+    err_exec = profile_execute_all(&profile, &vm);
+    // Counts up to an error are still useful, so always write them
+    profile_write(&profile, profile_fp);
+    profile_free(&profile);
+    fclose(profile_fp);
+  }
+  else
+    err_exec = vm_execute_all(&vm);
+  counters_stop(&counters);
+  if (repeat == 0)
+  {
+    retired = vm.stats.retired;
+    wall_ns = vm.stats.wall_ns;
+  }
+
+  // With --repeat, stats are of the last run and counters of every run
+  if (print_stats)
+    vm_stats_print_json(&vm, stderr);
+  if (print_counters)
+    counters_print_json(&counters, retired, wall_ns, stderr);
+  counters_close(&counters);
+
   if (err_exec != ERR_OK)
   {
     fprintf(stderr,
@@ -75,6 +285,7 @@ int main(int argc, char *argv[])
             "ERROR" TERM_RESET "]: Trace:\n",
             err_as_cstr(err_exec));
     vm_print_all(&vm, stderr);
+    vm_free(&vm);
     return -1;
   }
 
@@ -85,5 +296,6 @@ int main(int argc, char *argv[])
   }
 #endif
 
+  vm_free(&vm);
   return 0;
 }
@@ -6,9 +6,279 @@
 
 #include "./lexer.h"
 
-#include <ctype.h>
+#include <errno.h>
+#include <math.h>
 #include <string.h>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define S LEXER_CLASS_SPACE
+#define D LEXER_CLASS_DIGIT
+#define Y LEXER_CLASS_SYMBOL
+const byte LEXER_CLASSES[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, Y, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y,
+    Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, 0, 0, 0, 0, Y,
+    0, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y,
+    Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, Y, 0, 0, 0, 0, 0,
+    // Non ASCII characters are in no class
+};
+#undef S
+#undef D
+#undef Y
+
+size_t lexer_scan_space_scalar(const char *str, size_t n)
+{
+  size_t i = 0;
+  for (; i < n && LEXER_IS(LEXER_CLASS_SPACE, str[i]); ++i)
+    continue;
+  return i;
+}
+
+size_t lexer_scan_comment_scalar(const char *str, size_t n)
+{
+  size_t i = 0;
+  for (; i < n && str[i] != '\n' && str[i] != '\0'; ++i)
+    continue;
+  return i;
+}
+
+size_t lexer_scan_symbol_scalar(const char *str, size_t n)
+{
+  size_t i = 0;
+  for (; i < n && LEXER_IS(LEXER_CLASS_SYMBOL, str[i]); ++i)
+    continue;
+  return i;
+}
+
+/* Each vector scanner computes a mask of the characters which are in
+ * the run, 16 (SSE2) or 32 (AVX2) at a time, and stops at the first
+ * one which isn't.  Whatever is left over is done by the scalar
+ * scanner. */
+#if defined(__AVX2__)
+#define LEXER_VECTOR_SIZE 32
+typedef __m256i vec_t;
+#define VEC_LOAD(P)       _mm256_loadu_si256((const vec_t *)(P))
+#define VEC_SET(C)        _mm256_set1_epi8(C)
+#define VEC_EQ(A, B)      _mm256_cmpeq_epi8(A, B)
+#define VEC_OR(A, B)      _mm256_or_si256(A, B)
+#define VEC_SUB(A, B)     _mm256_sub_epi8(A, B)
+#define VEC_MIN(A, B)     _mm256_min_epu8(A, B)
+#define VEC_MASK(A)       ((u32)_mm256_movemask_epi8(A))
+#define VEC_FULL_MASK     0xFFFFFFFFU
+#elif defined(__SSE2__)
+#define LEXER_VECTOR_SIZE 16
+typedef __m128i vec_t;
+#define VEC_LOAD(P)       _mm_loadu_si128((const vec_t *)(P))
+#define VEC_SET(C)        _mm_set1_epi8(C)
+#define VEC_EQ(A, B)      _mm_cmpeq_epi8(A, B)
+#define VEC_OR(A, B)      _mm_or_si128(A, B)
+#define VEC_SUB(A, B)     _mm_sub_epi8(A, B)
+#define VEC_MIN(A, B)     _mm_min_epu8(A, B)
+#define VEC_MASK(A)       ((u32)_mm_movemask_epi8(A))
+#define VEC_FULL_MASK     0xFFFFU
+#endif
+
+#ifdef LEXER_VECTOR_SIZE
+// Lanes where LO <= x <= LO + RANGE, as unsigned bytes
+vec_t vec_in_range(vec_t x, char lo, char range)
+{
+  vec_t offset = VEC_SUB(x, VEC_SET(lo));
+  return VEC_EQ(VEC_MIN(offset, VEC_SET(range)), offset);
+}
+
+size_t lexer_scan_space(const char *str, size_t n)
+{
+  size_t i = 0;
+  for (; i + LEXER_VECTOR_SIZE <= n; i += LEXER_VECTOR_SIZE)
+  {
+    vec_t x = VEC_LOAD(str + i);
+    // ' ' or one of \t, \n, \v, \f, \r (which are contiguous)
+    u32 mask =
+        VEC_MASK(VEC_OR(VEC_EQ(x, VEC_SET(' ')), vec_in_range(x, '\t', 4)));
+    if (mask != VEC_FULL_MASK)
+      return i + __builtin_ctz(~mask);
+  }
+  return i + lexer_scan_space_scalar(str + i, n - i);
+}
+
+size_t lexer_scan_comment(const char *str, size_t n)
+{
+  size_t i = 0;
+  for (; i + LEXER_VECTOR_SIZE <= n; i += LEXER_VECTOR_SIZE)
+  {
+    vec_t x  = VEC_LOAD(str + i);
+    u32 mask =
+        VEC_MASK(VEC_OR(VEC_EQ(x, VEC_SET('\n')), VEC_EQ(x, VEC_SET(0))));
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + lexer_scan_comment_scalar(str + i, n - i);
+}
+
+size_t lexer_scan_symbol(const char *str, size_t n)
+{
+  size_t i = 0;
+  for (; i + LEXER_VECTOR_SIZE <= n; i += LEXER_VECTOR_SIZE)
+  {
+    vec_t x = VEC_LOAD(str + i);
+    // Setting 0x20 maps upper case letters onto lower case ones
+    vec_t letter = vec_in_range(VEC_OR(x, VEC_SET(0x20)), 'a', 25);
+    u32 mask     = VEC_MASK(VEC_OR(
+        letter, VEC_OR(VEC_EQ(x, VEC_SET('_')), VEC_EQ(x, VEC_SET('-')))));
+    if (mask != VEC_FULL_MASK)
+      return i + __builtin_ctz(~mask);
+  }
+  return i + lexer_scan_symbol_scalar(str + i, n - i);
+}
+#else
+size_t lexer_scan_space(const char *str, size_t n)
+{
+  return lexer_scan_space_scalar(str, n);
+}
+
+size_t lexer_scan_comment(const char *str, size_t n)
+{
+  return lexer_scan_comment_scalar(str, n);
+}
+
+size_t lexer_scan_symbol(const char *str, size_t n)
+{
+  return lexer_scan_symbol_scalar(str, n);
+}
+#endif
+
+// Value of a digit in bases up to 16, or 16 if it isn't one
+u64 lexer_digit(char c)
+{
+  if (LEXER_IS(LEXER_CLASS_DIGIT, c))
+    return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return 16;
+}
+
+// Powers of ten which are exact as doubles
+const double LEXER_POWERS_OF_TEN[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// mantissa / 10^fraction rounded to a float, if that can be done exactly
+// without the C library
+bool lexer_real(u64 mantissa, size_t fraction, float *real)
+{
+  if (fraction == 0)
+  {
+    *real = mantissa;
+    return true;
+  }
+  else if (mantissa > (1LU << 53) || fraction >= ARR_SIZE(LEXER_POWERS_OF_TEN))
+    return false;
+  // Both operands are exact so the quotient is rounded once.  Rounding
+  // it again to a float is only wrong if it's exactly halfway between
+  // two floats.
+  double quotient = mantissa / LEXER_POWERS_OF_TEN[fraction];
+  float rounded   = quotient;
+  float other = nextafterf(rounded, quotient > rounded ? INFINITY : -INFINITY);
+  if (quotient == ((double)rounded + other) / 2)
+    return false;
+  *real = rounded;
+  return true;
+}
+
+// Longest decimal literal converted on the stack when it has to go
+// through strtof
+#define LEXER_NUMBER_MAX 128
+
+size_t lexer_number(const char *str, size_t n, number_t *number)
+{
+  *number  = (number_t){0};
+  u64 base = 10, bits = 0;
+  size_t i = 0;
+  if (n >= 2 && str[0] == '0' && (str[1] | 0x20) == 'x')
+  {
+    base = 16;
+    bits = 4;
+    i    = 2;
+  }
+  else if (n >= 2 && str[0] == '0' && (str[1] | 0x20) == 'b')
+  {
+    base = 2;
+    bits = 1;
+    i    = 2;
+  }
+
+  // Digits of a power of two base which don't fit are counted as bits
+  // of exponent, remembering whether any were set for rounding
+  size_t start = i, digits = 0, fraction = 0, excess = 0;
+  bool overflow = false, sticky = false;
+  for (; i < n; ++i)
+  {
+    char c    = str[i];
+    u64 digit = lexer_digit(c);
+    if (digit < base)
+    {
+      ++digits;
+      fraction += (number->flags & NUMBER_POINT) != 0;
+      u64 next = 0;
+      if (overflow || __builtin_mul_overflow(number->integer, base, &next) ||
+          __builtin_add_overflow(next, digit, &next))
+      {
+        overflow = true;
+        excess += bits;
+        sticky = sticky || digit;
+      }
+      else
+        number->integer = next;
+    }
+    // Separators go between digits
+    else if (c == '_' && i > start && str[i - 1] != '_')
+      continue;
+    else if (c == '.' && base == 10 && !(number->flags & NUMBER_POINT) &&
+             i > start && str[i - 1] != '_')
+      number->flags |= NUMBER_POINT;
+    else
+      break;
+  }
+  if (digits == 0 || str[i - 1] == '_')
+  {
+    number->flags |= NUMBER_MALFORMED;
+    return i;
+  }
+  else if (overflow)
+    number->flags |= NUMBER_OVERFLOW;
+
+  if (base != 10)
+    // Anything below the top 60 bits only matters for rounding
+    number->real = ldexpf((float)(number->integer | sticky), excess);
+  else if (overflow || !lexer_real(number->integer, fraction, &number->real))
+  {
+    // Too many digits to be exact: leave it to the C library
+    char stack[LEXER_NUMBER_MAX];
+    char *copy  = i < sizeof(stack) ? stack : malloc(i + 1);
+    size_t size = 0;
+    for (size_t j = 0; j < i; ++j)
+      if (str[j] != '_')
+        copy[size++] = str[j];
+    copy[size]   = '\0';
+    errno        = 0;
+    number->real = strtof(copy, NULL);
+    if (errno == ERANGE)
+      number->flags |= NUMBER_RANGE;
+    if (copy != stack)
+      free(copy);
+  }
+  if (isinf(number->real))
+    number->flags |= NUMBER_RANGE;
+  return i;
+}
+
 const char *lerr_as_cstr(lerr_t lerr)
 {
   switch (lerr)
@@ -19,6 +289,10 @@ const char *lerr_as_cstr(lerr_t lerr)
     return "LERR_CHAR_WRONG_SIZE";
   case LERR_UNRECOGNISED_TOKEN:
     return "LERR_UNRECOGNISED_TOKEN";
+  case LERR_SOURCE_TOO_LARGE:
+    return "LERR_SOURCE_TOO_LARGE";
+  case LERR_NUMBER_MALFORMED:
+    return "LERR_NUMBER_MALFORMED";
   case LERR_OK:
     return "LERR_OK";
   default:
@@ -49,7 +323,47 @@ char *lerr_generate(lerr_t err, buffer_t *buffer)
   return message;
 }
 
-void token_print(token_t t, FILE *fp)
+const char *token_content(stream_t *stream, token_t token)
+{
+  return stream->source + token.offset;
+}
+
+bool token_equals(stream_t *stream, token_t token, const char *str)
+{
+  size_t size = strlen(str);
+  return token.size == size &&
+         memcmp(token_content(stream, token), str, size) == 0;
+}
+
+char token_as_char(stream_t *stream, token_t token)
+{
+  const char *content = token_content(stream, token);
+  // Escapes are kept as written, e.g. `\n`
+  if (token.size == 2 && content[0] == '\\')
+    return lexer_escape(content[1]);
+  return content[0];
+}
+
+char lexer_escape(char c)
+{
+  switch (c)
+  {
+  case 'n':
+    return '\n';
+  case 't':
+    return '\t';
+  case 'r':
+    return '\r';
+  case 'v':
+    return '\v';
+  case 'f':
+    return '\f';
+  default:
+    return 0;
+  }
+}
+
+void token_print(stream_t *stream, token_t t, FILE *fp)
 {
   const char *type_cstr = "";
   switch (t.type)
@@ -92,270 +406,505 @@ void token_print(token_t t, FILE *fp)
     break;
   }
 
-  fprintf(fp, "%s@(%lu,%lu)[size=%lu]: `%s`", type_cstr, t.column, t.line,
-          t.size, t.content);
+  fprintf(fp, "%s@%u[size=%u]: `%.*s`", type_cstr, t.offset, t.size,
+          (int)t.size, token_content(stream, t));
 }
 
 void stream_print(stream_t *stream, FILE *fp)
 {
   fprintf(fp, "STREAM=%s (cursor=%lu, number=%lu)\n", stream->name,
           stream->cursor, stream->size);
-  for (size_t i = 0; i < stream->size; ++i)
+  for (size_t i = stream->base; i < stream->size; ++i)
   {
-    token_print(stream->tokens[i], fp);
+    token_print(stream, stream_token(stream, i), fp);
     fprintf(fp, "\n");
   }
 }
 
-token_t token_create(token_type_t type, size_t col, size_t line, char *str,
-                     size_t size)
+token_t token_create(token_type_t type, size_t offset, size_t size)
+{
+  return (token_t){.type = type, .offset = offset, .size = size};
+}
+
+// Every array of the stream lives in one allocation: offsets, then
+// sizes, then types (so each array stays aligned)
+void stream_reserve(stream_t *stream, size_t capacity)
 {
-  token_t token = {.type    = type,
-                   .size    = size,
-                   .column  = col,
-                   .line    = line,
-                   .content = calloc(size + 1, sizeof(*str))};
-  if (str)
+  size_t kept  = stream->size - stream->base;
+  byte *block  = malloc(capacity * (sizeof(u32) * 2 + sizeof(byte)));
+  u32 *offsets = (u32 *)block;
+  u32 *sizes   = offsets + capacity;
+  byte *types  = (byte *)(sizes + capacity);
+  if (kept > 0)
   {
-    memcpy(token.content, str, size);
-    token.content[size] = '\0';
+    memcpy(offsets, stream->offsets, kept * sizeof(*offsets));
+    memcpy(sizes, stream->sizes, kept * sizeof(*sizes));
+    memcpy(types, stream->types, kept * sizeof(*types));
   }
-  else
-    memset(token.content, 0, size + 1);
-  return token;
+  free(stream->offsets);
+  stream->offsets  = offsets;
+  stream->sizes    = sizes;
+  stream->types    = types;
+  stream->capacity = capacity;
 }
 
-void free_arr_of_tokens(token_t *tokens, size_t number)
+// An entry in the side table of numbers
+typedef struct
+{
+  size_t index;
+  number_t number;
+} stream_number_t;
+
+// Drop every token before index, which must be in [base, size]
+void stream_drop(stream_t *stream, size_t index)
 {
-  for (size_t i = 0; i < number; ++i)
-    if (tokens[i].content)
-      free(tokens[i].content);
+  size_t dropped = index - stream->base, kept = stream->size - index;
+  if (dropped == 0)
+    return;
+  memmove(stream->offsets, stream->offsets + dropped,
+          kept * sizeof(*stream->offsets));
+  memmove(stream->sizes, stream->sizes + dropped,
+          kept * sizeof(*stream->sizes));
+  memmove(stream->types, stream->types + dropped,
+          kept * sizeof(*stream->types));
+  stream->base = index;
+
+  stream_number_t *numbers = stream->numbers.data;
+  size_t first             = 0;
+  for (; first < stream->numbers.used && numbers[first].index < index; ++first)
+    continue;
+  memmove(numbers, numbers + first,
+          (stream->numbers.used - first) * sizeof(*numbers));
+  stream->numbers.used -= first;
+  stream->number_hint = 0;
 }
 
-lerr_t tokenise_buffer(stream_t *stream, buffer_t *buffer)
+// The first token a streaming lexer has to keep
+size_t stream_keep_from(stream_t *stream)
 {
-  stream->name   = buffer->name;
-  stream->cursor = 0;
+  size_t keep = stream->cursor > LEXER_LOOKBEHIND
+                    ? stream->cursor - LEXER_LOOKBEHIND
+                    : 0;
+  return MIN(MAX(keep, stream->base), stream->size);
+}
 
-  if (buffer_at_end(*buffer) == BUFFER_PAST_END)
+void stream_append(stream_t *stream, token_t token)
+{
+  if (stream->size - stream->base == stream->capacity && stream->input)
+    stream_drop(stream, stream_keep_from(stream));
+  if (stream->size - stream->base == stream->capacity)
+    stream_reserve(stream, MAX(stream->capacity * 2, LEXER_MIN_CAPACITY));
+  if (token.type == TOKEN_NUMBER)
+  {
+    stream_number_t entry = {stream->size, token.number};
+    DARR_APP(&stream->numbers, stream_number_t, entry);
+  }
+  size_t slot           = stream->size - stream->base;
+  stream->offsets[slot] = token.offset;
+  stream->sizes[slot]   = token.size;
+  stream->types[slot]   = token.type;
+  ++stream->size;
+}
+
+size_t lexer_estimate_tokens(buffer_t *buffer)
+{
+  // Most tokens are separated by whitespace, so every run of whitespace
+  // is about two tokens.  Punctuation may not be, so count it too.
+  // Overestimates (e.g. whitespace in comments) only cost a little
+  // memory; underestimates cost a regrowth.
+  size_t estimate = 1;
+  bool prev_space = false;
+  for (size_t i = buffer->cur; i < buffer->available; ++i)
+  {
+    char c     = buffer->data[i];
+    bool space = LEXER_IS(LEXER_CLASS_SPACE, c);
+    estimate += (space && !prev_space) * 2;
+    estimate += c == '*' || c == '.' || c == '^' || c == '\'' || c == ';';
+    prev_space = space;
+  }
+  // Tokens are at least one byte long
+  return MIN(estimate, buffer_space_left(*buffer) + 2);
+}
+
+lerr_t lexer_next(buffer_t *buffer, token_t *token)
+{
+  // The buffer may be a view into a larger source, in which case the
+  // byte after it isn't a NUL
+  if (buffer_at_end(*buffer) == BUFFER_AT_END)
   {
-    stream->tokens = NULL;
-    stream->size   = 0;
+    *token = token_create(TOKEN_EOF, buffer->cur++, 1);
     return LERR_OK;
   }
+  char c = buffer_pop(buffer);
+  switch (c)
+  {
+  case '\0':
+    *token = token_create(TOKEN_EOF, buffer->cur - 1, 1);
+    break;
+  case '.':
+    *token = token_create(TOKEN_DOT, buffer->cur - 1, 1);
+    break;
+  case '^':
+    *token = token_create(TOKEN_HAT, buffer->cur - 1, 1);
+    break;
+  case '*':
+    *token = token_create(TOKEN_STAR, buffer->cur - 1, 1);
+    break;
+  case ';': {
+    // Figure out the size of our comment (until newline or eof)
+    size_t comment_size = lexer_scan_comment(buffer->data + buffer->cur,
+                                             buffer_space_left(*buffer));
+    *token = token_create(TOKEN_COMMENT, buffer->cur, comment_size);
+    buffer->cur += comment_size;
+    break;
+  }
+  case '\'': {
+    // This may be a character literal
+    if (buffer_peek(*buffer) == '\\' && buffer->data[buffer->cur + 2] == '\'')
+    {
+      // Escape sequence, kept as written and decoded by token_as_char
+      if (!lexer_escape(buffer->data[buffer->cur + 1]))
+        return LERR_CHAR_UNRECOGNISED_ESCAPE;
+      *token = token_create(TOKEN_CHARACTER, buffer->cur, 2);
+      buffer->cur += 3;
+    }
+    else
+    {
+      // NOTE: ASCII specific (no unicode hence one byte checks)
+      if (buffer->data[buffer->cur + 1] != '\'')
+        return LERR_CHAR_WRONG_SIZE;
+      *token = token_create(TOKEN_CHARACTER, buffer->cur, 1);
+      buffer->cur += 2;
+    }
+    break;
+  }
+  default:
+    if (LEXER_IS(LEXER_CLASS_SPACE, c))
+    {
+      size_t i = lexer_scan_space(buffer->data + buffer->cur,
+                                  buffer_space_left(*buffer));
+      *token   = token_create(TOKEN_WHITESPACE, buffer->cur - 1, i + 1);
+      buffer->cur += i;
+      break;
+    }
+    else if (c == '-' &&
+             (LEXER_IS(LEXER_CLASS_SPACE, buffer_peek(*buffer)) ||
+              buffer_peek(*buffer) == 0))
+      *token = token_create(TOKEN_DASH, buffer->cur - 1, 1);
+    // Number parsers
+    else if (LEXER_IS(LEXER_CLASS_DIGIT, c) ||
+             (c == '-' && LEXER_IS(LEXER_CLASS_DIGIT, buffer_peek(*buffer))))
+    {
+      // Evaluated from the first digit, the sign is only a flag
+      size_t first = buffer->cur - 1;
+      size_t start = c == '-' ? buffer->cur : first;
+      number_t number;
+      size_t size = lexer_number(buffer->data + start,
+                                 buffer->available - start, &number);
+      buffer->cur = start + size;
+      if (number.flags & NUMBER_MALFORMED)
+        return LERR_NUMBER_MALFORMED;
+      else if (c == '-')
+        number.flags |= NUMBER_NEGATIVE;
+      *token        = token_create(TOKEN_NUMBER, first, buffer->cur - first);
+      token->number = number;
+    }
+    else if (LEXER_IS(LEXER_CLASS_SYMBOL, c))
+    {
+      size_t symbol_size = lexer_scan_symbol(buffer->data + buffer->cur,
+                                             buffer_space_left(*buffer));
+      *token = token_create(TOKEN_SYMBOL, buffer->cur - 1, symbol_size + 1);
+      buffer->cur += symbol_size;
+    }
+    else
+      return LERR_UNRECOGNISED_TOKEN;
+    break;
+  }
+  return LERR_OK;
+}
 
-  darr_t tokens = {0};
-  darr_init(&tokens, 1, sizeof(token_t));
+lerr_t tokenise_buffer(stream_t *stream, buffer_t *buffer)
+{
+  *stream = (stream_t){.name        = buffer->name,
+                       .source      = buffer->data,
+                       .source_size = buffer->available,
+                       .lerr        = LERR_OK};
 
-  size_t column = 0, line = 1;
+  if (buffer_at_end(*buffer) == BUFFER_PAST_END)
+    return LERR_OK;
+  else if (buffer->available > UINT32_MAX)
+    return LERR_SOURCE_TOO_LARGE;
+
+  stream_reserve(stream, lexer_estimate_tokens(buffer));
+  darr_init(&stream->numbers, DARR_INITAL_SIZE, sizeof(stream_number_t));
 
   while (buffer_at_end(*buffer) != BUFFER_PAST_END)
   {
     token_t token = {0};
-    char c        = buffer_pop(buffer);
-    switch (c)
+    lerr_t lerr   = lexer_next(buffer, &token);
+    if (lerr != LERR_OK)
     {
-    case '\0':
-      token = token_create(TOKEN_EOF, column, line, &c, 1);
-      ++column;
-      break;
-    case '.':
-      token = token_create(TOKEN_DOT, column, line, &c, 1);
-      ++column;
-      break;
-    case '^':
-      token = token_create(TOKEN_HAT, column, line, &c, 1);
-      ++column;
-      break;
-    case '*':
-      token = token_create(TOKEN_STAR, column, line, &c, 1);
-      ++column;
-      break;
-    case ';': {
-      // Figure out the size of our comment (until newline or eof)
-      size_t comment_size = 0;
-      for (char comment_char = buffer->data[buffer->cur + comment_size];
-           comment_size < buffer_space_left(*buffer) &&
-           !(comment_char == '\n' || comment_char == '\0');
-           comment_char = buffer->data[buffer->cur + (++comment_size)])
-        continue;
-      token = token_create(TOKEN_COMMENT, column, line,
-                           buffer->data + buffer->cur, comment_size);
-      column += comment_size + 1;
-      buffer->cur += comment_size;
-      break;
+      stream_free(stream);
+      return lerr;
     }
-    case '\'': {
-      // This may be a character literal
-      if (buffer_peek(*buffer) == '\\' && buffer->data[buffer->cur + 2] == '\'')
-      {
-        // Escape sequence parsing
-        char escaped = 0;
-        switch (buffer->data[buffer->cur + 1])
-        {
-        case 'n':
-          escaped = '\n';
-          break;
-        case 't':
-          escaped = '\t';
-          break;
-        case 'r':
-          escaped = '\r';
-          break;
-        case 'v':
-          escaped = '\v';
-          break;
-        case 'f':
-          escaped = '\f';
-          break;
-        default:
-          free_arr_of_tokens(tokens.data, tokens.used);
-          darr_free(&tokens);
-          stream_free(stream);
-          return LERR_CHAR_UNRECOGNISED_ESCAPE;
-          break;
-        }
-        ++column;
-        token = token_create(TOKEN_CHARACTER, column, line, &escaped, 1);
-        column += 3;
-        buffer->cur += 3;
-      }
-      else
-      {
-        // NOTE: ASCII specific (no unicode hence one byte checks)
-        if (buffer->data[buffer->cur + 1] != '\'')
-        {
-          free_arr_of_tokens(tokens.data, tokens.used);
-          darr_free(&tokens);
-          return LERR_CHAR_WRONG_SIZE;
-        }
-
-        ++column;
-        token = token_create(TOKEN_CHARACTER, column, line,
-                             buffer->data + buffer->cur, 1);
-        buffer->cur += 2;
-        column += 2;
-      }
-      break;
+    // Append token to our current set
+    stream_append(stream, token);
+  }
+
+  return LERR_OK;
+}
+
+// Bytes kept zeroed past the end of a window, so the lexer can look a
+// few characters ahead of the NUL terminator like it can with buffers
+#define LEXER_WINDOW_SLACK 4
+
+void stream_init_file(stream_t *stream, const char *name, FILE *fp)
+{
+  *stream = (stream_t){.name            = name,
+                       .input           = fp,
+                       .window_capacity = LEXER_WINDOW_SIZE,
+                       .lerr            = LERR_OK};
+  stream->window = calloc(LEXER_WINDOW_SIZE + LEXER_WINDOW_SLACK, 1);
+  stream->source = stream->window;
+  stream_reserve(stream, LEXER_MIN_CAPACITY);
+  darr_init(&stream->numbers, DARR_INITAL_SIZE, sizeof(stream_number_t));
+}
+
+void stream_init_feed(stream_t *stream, const char *name, const char *source,
+                      size_t source_size, bool (*feed)(stream_t *),
+                      void *context)
+{
+  *stream = (stream_t){.name         = name,
+                       .source       = source,
+                       .source_size  = source_size,
+                       .lerr         = LERR_OK,
+                       .feed         = feed,
+                       .feed_context = context};
+  stream_reserve(stream, LEXER_MIN_CAPACITY);
+  darr_init(&stream->numbers, DARR_INITAL_SIZE, sizeof(stream_number_t));
+}
+
+// Slide the window past every byte which is no longer needed then read
+// as much of the input as fits
+lerr_t stream_fill(stream_t *stream)
+{
+  stream_drop(stream, stream_keep_from(stream));
+  size_t discard = stream->size > stream->base ? stream->offsets[0]
+                                               : stream->window_cur;
+  for (size_t i = 0; i < discard; ++i)
+  {
+    if (stream->window[i] == '\n')
+    {
+      stream->window_column = 0;
+      ++stream->window_line;
     }
-    default:
-      if (isspace(c))
-      {
-        size_t prev_col  = column;
-        size_t prev_line = line;
-
-        ++column;
-        if (c == '\n')
-        {
-          column = 0;
-          ++line;
-        }
-
-        size_t i = 0;
-        for (c = buffer_peek(*buffer);
-             i < buffer_space_left(*buffer) && isspace(c);
-             c = buffer->data[buffer->cur + (++i)])
-        {
-          ++column;
-          if (c == '\n')
-          {
-            column = 0;
-            ++line;
-          }
-          continue;
-        }
-        token = token_create(TOKEN_WHITESPACE, prev_col, prev_line, NULL, i);
-        buffer->cur += i;
-        break;
-      }
-      else if (c == '-' &&
-               (isspace(buffer_peek(*buffer)) || buffer_peek(*buffer) == 0))
-      {
-        token = token_create(TOKEN_DASH, column, line, &c, 1);
-        ++column;
-      }
-      // Number parsers
-      else if (isdigit(c) || (c == '-' && isdigit(buffer_peek(*buffer))))
-      {
-        bool decimal_place = false;
-        size_t number_size = 0;
-        for (char n_char = buffer_peek(*buffer);
-             number_size < buffer_space_left(*buffer) &&
-             (isdigit(n_char) || (n_char == '.' && !decimal_place));
-             n_char = buffer->data[buffer->cur + (++number_size)])
-          if (n_char == '.')
-            decimal_place = true;
-        token = token_create(TOKEN_NUMBER, column, line,
-                             buffer->data + buffer->cur - 1, number_size + 1);
-        column += number_size + 1;
-        buffer->cur += number_size;
-      }
-      else if (strchr(LEXER_SYMBOL_ACCEPTED, c))
-      {
-        size_t symbol_size = 0;
-        for (char symbol_char = buffer_peek(*buffer);
-             symbol_size < buffer_space_left(*buffer) &&
-             strchr(LEXER_SYMBOL_ACCEPTED, symbol_char);
-             symbol_char = buffer->data[buffer->cur + (++symbol_size)])
-          continue;
-        token = token_create(TOKEN_SYMBOL, column, line,
-                             buffer->data + buffer->cur - 1, symbol_size + 1);
-        column += symbol_size + 1;
-        buffer->cur += symbol_size;
-      }
-      else
+    else
+      ++stream->window_column;
+  }
+  size_t used = stream->source_size - discard;
+  memmove(stream->window, stream->window + discard, used);
+  for (size_t i = 0; i < stream->size - stream->base; ++i)
+    stream->offsets[i] -= discard;
+  stream->window_cur -= discard;
+
+  // Only a token as big as the window can fill it
+  if (used == stream->window_capacity)
+  {
+    if (stream->window_capacity * 2 > UINT32_MAX)
+      return LERR_SOURCE_TOO_LARGE;
+    stream->window_capacity *= 2;
+    stream->window =
+        realloc(stream->window, stream->window_capacity + LEXER_WINDOW_SLACK);
+  }
+
+  size_t wanted = stream->window_capacity - used;
+  size_t got    = fread(stream->window + used, 1, wanted, stream->input);
+  // fread only returns short at the end of the input (or on error)
+  stream->input_eof = got < wanted;
+  used += got;
+  memset(stream->window + used, 0, LEXER_WINDOW_SLACK);
+  stream->source      = stream->window;
+  stream->source_size = used;
+  return LERR_OK;
+}
+
+// Lex the next token of a streaming stream
+void stream_lex_next(stream_t *stream)
+{
+  bool more = stream->source_size - stream->window_cur < LEXER_LOOKAHEAD;
+  while (!stream->finished)
+  {
+    if (more && !stream->input_eof)
+    {
+      stream->lerr = stream_fill(stream);
+      if (stream->lerr != LERR_OK)
       {
-        free_arr_of_tokens(tokens.data, tokens.used);
-        darr_free(&tokens);
-        return LERR_UNRECOGNISED_TOKEN;
+        stream->finished = true;
+        return;
       }
-      break;
     }
-    // Append token to our current set
-    DARR_APP(&tokens, token_t, token);
+
+    if (stream->input_eof && stream->window_cur == stream->source_size)
+    {
+      // The NUL terminator: a buffer lexes it as TOKEN_EOF unless it's
+      // empty, so do the same
+      if (stream->size > 0)
+        stream_append(stream,
+                      token_create(TOKEN_EOF, stream->window_cur, 1));
+      stream->finished = true;
+      return;
+    }
+
+    buffer_t buffer = {.name      = stream->name,
+                       .data      = stream->window,
+                       .cur       = stream->window_cur,
+                       .available = stream->source_size};
+    token_t token   = {0};
+    lerr_t lerr     = lexer_next(&buffer, &token);
+    // A token reaching the end of the window may carry on past it, so
+    // read more and lex it again
+    more = !stream->input_eof && buffer.cur >= stream->source_size;
+    if (more)
+      continue;
+
+    stream->window_cur = buffer.cur;
+    if (lerr != LERR_OK)
+    {
+      stream->lerr     = lerr;
+      stream->finished = true;
+      return;
+    }
+    stream_append(stream, token);
+    return;
   }
+}
 
-  darr_tighten(&tokens);
-  stream->tokens = tokens.data;
-  stream->size   = tokens.used;
-  return LERR_OK;
+// Line and column of an offset into the source
+void stream_offset_position(stream_t *stream, size_t offset, size_t *line,
+                            size_t *column)
+{
+  *line   = stream->window_line + 1;
+  *column = stream->window_column;
+  for (size_t i = 0; i < offset; ++i)
+  {
+    if (stream->source[i] == '\n')
+    {
+      *column = 0;
+      ++*line;
+    }
+    else
+      ++*column;
+  }
+}
+
+char *stream_lerr_generate(stream_t *stream)
+{
+  const char *err_cstr = lerr_as_cstr(stream->lerr);
+  size_t line = 0, column = 0;
+  stream_offset_position(stream, stream->window_cur, &line, &column);
+  int char_num_size =
+      snprintf(NULL, 0, "%s:%zu:%zu: %s", stream->name, line, column, err_cstr);
+  char *message = calloc(char_num_size + 1, sizeof(*message));
+  sprintf(message, "%s:%zu:%zu: %s", stream->name, line, column, err_cstr);
+  message[char_num_size] = '\0';
+  return message;
+}
+
+bool stream_position(stream_t *stream, size_t index, size_t *line,
+                     size_t *column)
+{
+  if (index < stream->base)
+    return false;
+  size_t offset = index < stream->size ? stream->offsets[index - stream->base]
+                                       : stream->source_size;
+  stream_offset_position(stream, offset, line, column);
+  return true;
+}
+
+bool stream_at_end(stream_t *stream)
+{
+  if (stream->cursor >= stream->size && stream->input)
+    stream_lex_next(stream);
+  // A feed may append nothing, so call it until it does or ends
+  while (stream->cursor >= stream->size && stream->feed && !stream->finished)
+    stream->finished = !stream->feed(stream);
+  return stream->cursor >= stream->size;
+}
+
+const char *stream_intern(stream_t *stream, token_t token)
+{
+  if (!stream->input)
+    return token_content(stream, token);
+  return arena_copy(&stream->names, token_content(stream, token), token.size);
+}
+
+// Value of the number token at index
+number_t stream_number(stream_t *stream, size_t index)
+{
+  stream_number_t *numbers = stream->numbers.data;
+  size_t used = stream->numbers.used, hint = stream->number_hint;
+  // Tokens are mostly read in order, so try after the last lookup first
+  for (size_t i = hint; i < MIN(hint + 2, used); ++i)
+    if (numbers[i].index == index)
+    {
+      stream->number_hint = i;
+      return numbers[i].number;
+    }
+
+  size_t low = 0, high = used;
+  while (low < high)
+  {
+    size_t mid = low + (high - low) / 2;
+    if (numbers[mid].index < index)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low == used || numbers[low].index != index)
+    return (number_t){0};
+  stream->number_hint = low;
+  return numbers[low].number;
+}
+
+token_t stream_token(stream_t *stream, size_t index)
+{
+  size_t slot   = index - stream->base;
+  token_t token = token_create(stream->types[slot], stream->offsets[slot],
+                               stream->sizes[slot]);
+  if (token.type == TOKEN_NUMBER)
+    token.number = stream_number(stream, index);
+  return token;
 }
 
 void stream_seek_next(stream_t *stream)
 {
-  for (; stream->cursor < stream->size &&
-         (stream->tokens[stream->cursor].type == TOKEN_WHITESPACE ||
-          stream->tokens[stream->cursor].type == TOKEN_COMMENT);
+  for (; !stream_at_end(stream) &&
+         (stream->types[stream->cursor - stream->base] == TOKEN_WHITESPACE ||
+          stream->types[stream->cursor - stream->base] == TOKEN_COMMENT);
        ++stream->cursor)
     continue;
 }
 
 token_t stream_peek(stream_t *stream)
 {
-  if (stream->cursor > stream->size)
-    return (token_t){.type    = TOKEN_OTHER,
-                     .content = NULL,
-                     .size    = 0,
-                     .column  = 0,
-                     .line    = 0};
-  return stream->tokens[stream->cursor];
+  if (stream_at_end(stream))
+    return token_create(TOKEN_OTHER, 0, 0);
+  return stream_token(stream, stream->cursor);
 }
 
 token_t stream_pop(stream_t *stream)
 {
-  if (stream->cursor > stream->size)
-    return (token_t){.type    = TOKEN_OTHER,
-                     .content = NULL,
-                     .size    = 0,
-                     .column  = 0,
-                     .line    = 0};
-  return stream->tokens[stream->cursor++];
+  if (stream_at_end(stream))
+    return token_create(TOKEN_OTHER, 0, 0);
+  return stream_token(stream, stream->cursor++);
 }
 
 void stream_free(stream_t *stream)
 {
-  for (size_t i = 0; i < stream->size; ++i)
-    free(stream->tokens[i].content);
-  free(stream->tokens);
+  // offsets is the start of the one allocation
+  free(stream->offsets);
+  darr_free(&stream->numbers);
+  free(stream->window);
+  arena_free(&stream->names);
   *stream = (stream_t){0};
 }
@@ -8,6 +8,8 @@ typedef enum
   LERR_CHAR_UNRECOGNISED_ESCAPE,
   LERR_CHAR_WRONG_SIZE,
   LERR_UNRECOGNISED_TOKEN,
+  LERR_SOURCE_TOO_LARGE,
+  LERR_NUMBER_MALFORMED,
   LERR_OK
 } lerr_t;
 
@@ -35,29 +37,169 @@ typedef enum
   TOKEN_OTHER,
 } token_type_t;
 
+/* Number literals are evaluated by the lexer, as it finds where they
+ * end.  They're decimal (with an optional decimal point), hexadecimal
+ * with 0x or binary with 0b, may have a leading - and may have _
+ * between any two digits.  The value is kept as a magnitude, both as
+ * an integer and rounded to a float (like strtof). */
+#define NUMBER_NEGATIVE (1 << 0)
+#define NUMBER_POINT    (1 << 1)
+// The integer doesn't fit in a u64
+#define NUMBER_OVERFLOW (1 << 2)
+// The float overflowed or underflowed, like ERANGE from strtof
+#define NUMBER_RANGE (1 << 3)
+// No digits, or a _ which isn't between two
+#define NUMBER_MALFORMED (1 << 4)
+
+typedef struct
+{
+  u64 integer;
+  float real;
+  byte flags;
+} number_t;
+
+// Evaluate the number literal (without its sign) at the start of a
+// string of size n, returning its size
+size_t lexer_number(const char *, size_t, number_t *);
+
+// A token is a view into the source of its stream: it doesn't own its
+// content, so the source must outlive the stream.  Streams don't store
+// token_t, see stream_t.
 typedef struct
 {
   token_type_t type;
-  char *content;
-  size_t size, column, line;
+  u32 offset, size;
+  // TOKEN_NUMBER only
+  number_t number;
 } token_t;
 
 #define LEXER_SYMBOL_ACCEPTED \
   "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_-"
 
-token_t token_create(token_type_t, size_t, size_t, char *, size_t);
-void token_print(token_t, FILE *);
+/* Character classes, indexed by (unsigned) character.  Symbols are made
+ * of LEXER_SYMBOL_ACCEPTED, whitespace is the same as isspace in the C
+ * locale. */
+#define LEXER_CLASS_SPACE  (1 << 0)
+#define LEXER_CLASS_DIGIT  (1 << 1)
+#define LEXER_CLASS_SYMBOL (1 << 2)
 
-typedef struct
+extern const byte LEXER_CLASSES[256];
+
+#define LEXER_IS(CLASS, C) ((LEXER_CLASSES[(byte)(C)] & (CLASS)) != 0)
+
+/* Run scanners: the number of leading characters of a string of size n
+ * which are whitespace, comment body (anything but newline or NUL) or
+ * symbol characters respectively.  These use SSE2 or AVX2 when compiled
+ * for them, and the _scalar versions otherwise. */
+size_t lexer_scan_space(const char *, size_t);
+size_t lexer_scan_comment(const char *, size_t);
+size_t lexer_scan_symbol(const char *, size_t);
+
+size_t lexer_scan_space_scalar(const char *, size_t);
+size_t lexer_scan_comment_scalar(const char *, size_t);
+size_t lexer_scan_symbol_scalar(const char *, size_t);
+
+token_t token_create(token_type_t, size_t offset, size_t size);
+
+// Initial number of tokens to reserve if a stream has to grow
+#define LEXER_MIN_CAPACITY 64
+
+/* Streaming: bytes read from the input at a time (the window grows past
+ * this only for a token longer than it), the number of bytes which must
+ * be available past the next token to lex one without reading and the
+ * number of tokens behind the cursor which are kept. */
+#define LEXER_WINDOW_SIZE (64 * 1024)
+#define LEXER_LOOKAHEAD   64
+#define LEXER_LOOKBEHIND  16
+
+/* Tokens are stored as a structure of arrays (9 bytes a token) in one
+ * allocation, sized from an estimate made before tokenising.  Line and
+ * column aren't stored: see stream_position.  The values of number
+ * tokens are in a side table of (index, number_t), in token order.
+ *
+ * A stream either tokenises a whole buffer at once (tokenise_buffer) or
+ * lexes tokens on demand from a FILE (stream_init_file).  When
+ * streaming, source is a window over the input which slides forward as
+ * the cursor does: only the tokens from LEXER_LOOKBEHIND before the
+ * cursor are kept, in slots [0, size - base) of the arrays, and offsets
+ * are into the window.  Indices (cursor, size, stream_token) are
+ * absolute in both modes.
+ *
+ * A third mode is a stream fed tokens of a source in memory by another
+ * part of the program (stream_init_feed): whenever the cursor reaches
+ * the end of the tokens, feed is called to append more and returns
+ * false once there are none left.  A feed which stops at a lexer error
+ * records it in lerr and its offset in window_cur, as if streaming. */
+typedef struct stream
 {
   const char *name;
-  token_t *tokens;
-  size_t cursor, size;
+  const char *source;
+  size_t source_size;
+  u32 *offsets, *sizes;
+  byte *types;
+  size_t cursor, size, capacity, base;
+  darr_t numbers;
+  size_t number_hint;
+
+  // Streaming only
+  FILE *input;
+  char *window;
+  size_t window_capacity, window_cur;
+  // Lines and columns in the input before the window
+  size_t window_line, window_column;
+  bool input_eof, finished;
+  lerr_t lerr;
+  arena_t names;
+
+  // Fed only
+  bool (*feed)(struct stream *);
+  void *feed_context;
 } stream_t;
 
+// Pointer to the first character of a token (not NUL terminated)
+const char *token_content(stream_t *, token_t);
+// Whether the content of a token is exactly the given string
+bool token_equals(stream_t *, token_t, const char *);
+// The character a TOKEN_CHARACTER represents, with escapes decoded
+char token_as_char(stream_t *, token_t);
+void token_print(stream_t *, token_t, FILE *);
+
+// Returns the character an escape sequence (without the backslash)
+// represents, or 0 if it isn't recognised
+char lexer_escape(char);
+
+// Lex one token from the buffer, leaving it at the end of the token or,
+// on error, where the error was found
+lerr_t lexer_next(buffer_t *, token_t *);
 lerr_t tokenise_buffer(stream_t *stream, buffer_t *buffer);
 
+// Start streaming tokens from a file (which may be a pipe): nothing is
+// read until the first token is needed.  Lexer errors end the stream
+// and are recorded in lerr.
+void stream_init_file(stream_t *, const char *name, FILE *);
+// Start a stream over source (which must outlive it) whose tokens are
+// appended by feed, see stream_t.  Tokens are kept as with a buffer.
+void stream_init_feed(stream_t *, const char *name, const char *source,
+                      size_t source_size, bool (*feed)(stream_t *),
+                      void *context);
+// Append a token lexed from the stream's source, e.g. by a feed
+void stream_append(stream_t *, token_t);
+// lerr_generate for the error which ended a stream
+char *stream_lerr_generate(stream_t *);
+
 void stream_print(stream_t *, FILE *);
+// index must not be behind base
+token_t stream_token(stream_t *, size_t index);
+// Line and column of the index'th token (or the end of the source if
+// it's past the end), computed from the source.  Returns false if the
+// token has been dropped by a streaming lexer.
+bool stream_position(stream_t *, size_t index, size_t *line, size_t *column);
+// Whether every token has been consumed, lexing the next one if
+// streaming or feeding more if fed
+bool stream_at_end(stream_t *);
+// Content of a token which stays valid until the stream is freed (and,
+// when tokenising a buffer, the buffer is)
+const char *stream_intern(stream_t *, token_t);
 void stream_seek_next(stream_t *);
 token_t stream_peek(stream_t *);
 token_t stream_pop(stream_t *);
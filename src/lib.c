@@ -4,11 +4,15 @@
  * Description: General library functions
  */
 
+// For clock_gettime
+#define _POSIX_C_SOURCE 199309L
+
 #include "./lib.h"
 
 #include <ctype.h>
 #include <malloc.h>
 #include <string.h>
+#include <time.h>
 
 buffer_t buffer_read_file(const char *name, FILE *fp)
 {
@@ -161,3 +165,128 @@ void darr_mem_insert(darr_t *darr, void *ptr, size_t size, size_t where)
   memcpy(((int8_t *)darr->data) + (darr->member_size * where), ptr,
          size * darr->member_size);
 }
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+  // Keep every allocation word aligned
+  size = (size + sizeof(word) - 1) & ~(sizeof(word) - 1);
+  if (!arena->head || arena->head->used + size > arena->head->size)
+  {
+    // Oversized allocations get a block of their own
+    size_t block_size    = MAX(size, ARENA_BLOCK_SIZE);
+    arena_block_t *block = malloc(sizeof(*block) + block_size);
+    block->next          = arena->head;
+    block->used          = 0;
+    block->size          = block_size;
+    arena->head          = block;
+  }
+  void *ptr = arena->head->data + arena->head->used;
+  arena->head->used += size;
+  return ptr;
+}
+
+char *arena_copy(arena_t *arena, const void *ptr, size_t size)
+{
+  char *copy = arena_alloc(arena, size + 1);
+  memcpy(copy, ptr, size);
+  copy[size] = '\0';
+  return copy;
+}
+
+void arena_free(arena_t *arena)
+{
+  for (arena_block_t *block = arena->head, *next = NULL; block; block = next)
+  {
+    next = block->next;
+    free(block);
+  }
+  arena->head = NULL;
+}
+
+u64 hash_bytes(const void *ptr, size_t size)
+{
+  const byte *bytes = ptr;
+  u64 hash          = 0xCBF29CE484222325LU;
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ bytes[i]) * 0x100000001B3LU;
+  return hash;
+}
+
+void htab_init(htab_t *htab, size_t initial_size)
+{
+  // Capacity is a power of two so probes can wrap with a mask
+  size_t capacity = HTAB_INITIAL_SIZE;
+  while (capacity < initial_size)
+    capacity *= 2;
+  htab->entries  = calloc(capacity, sizeof(*htab->entries));
+  htab->used     = 0;
+  htab->capacity = capacity;
+  htab->keys     = (arena_t){0};
+}
+
+void htab_free(htab_t *htab)
+{
+  free(htab->entries);
+  arena_free(&htab->keys);
+  *htab = (htab_t){0};
+}
+
+// The entry for a key, or the empty slot it would go in
+htab_entry_t *htab_find(htab_t *htab, const char *key, size_t size, u64 hash)
+{
+  size_t mask = htab->capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask)
+  {
+    htab_entry_t *entry = htab->entries + i;
+    if (!entry->key || (entry->hash == hash && entry->size == size &&
+                        memcmp(entry->key, key, size) == 0))
+      return entry;
+  }
+}
+
+void htab_grow(htab_t *htab)
+{
+  htab_entry_t *old = htab->entries;
+  size_t capacity   = htab->capacity;
+  htab->capacity    = MAX(capacity * 2, HTAB_INITIAL_SIZE);
+  htab->entries     = calloc(htab->capacity, sizeof(*htab->entries));
+  for (size_t i = 0; i < capacity; ++i)
+    if (old[i].key)
+      *htab_find(htab, old[i].key, old[i].size, old[i].hash) = old[i];
+  free(old);
+}
+
+bool htab_insert(htab_t *htab, const char *key, size_t size, word value)
+{
+  // Keep the load factor under 3/4 so probes stay short
+  if ((htab->used + 1) * 4 > htab->capacity * 3)
+    htab_grow(htab);
+  u64 hash            = hash_bytes(key, size);
+  htab_entry_t *entry = htab_find(htab, key, size, hash);
+  if (entry->key)
+    return false;
+  *entry = (htab_entry_t){.key   = arena_copy(&htab->keys, key, size),
+                          .size  = size,
+                          .hash  = hash,
+                          .value = value};
+  ++htab->used;
+  return true;
+}
+
+bool htab_get(htab_t *htab, const char *key, size_t size, word *value)
+{
+  if (htab->capacity == 0)
+    return false;
+  htab_entry_t *entry = htab_find(htab, key, size, hash_bytes(key, size));
+  if (!entry->key)
+    return false;
+  *value = entry->value;
+  return true;
+}
+
+u64 time_now_ns(void)
+{
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((u64)ts.tv_sec * 1000000000LU) + ts.tv_nsec;
+}
@@ -22,6 +22,7 @@
 
 typedef uint64_t u64;
 typedef int64_t i64;
+typedef uint32_t u32;
 typedef u64 word;
 typedef uint8_t byte;
 
@@ -76,4 +77,56 @@ void darr_mem_insert(darr_t *, void *, size_t, size_t);
 
 #define DARR_MEMBER(DARR, TYPE, INDEX) ((TYPE *)(DARR)->data)[INDEX]
 
+/* Arena of blocks: unlike a darr, memory allocated from an arena never
+ * moves, so pointers into it stay valid until arena_free. */
+#define ARENA_BLOCK_SIZE 4096
+typedef struct arena_block
+{
+  struct arena_block *next;
+  size_t used, size;
+  char data[];
+} arena_block_t;
+
+typedef struct
+{
+  arena_block_t *head;
+} arena_t;
+
+void *arena_alloc(arena_t *, size_t);
+// Copy of the given memory with a NUL appended
+char *arena_copy(arena_t *, const void *, size_t);
+void arena_free(arena_t *);
+
+/* Hash table from strings to words, by open addressing with linear
+ * probing.  Keys are interned: the table copies each key into its own
+ * arena, so they may be views into memory which doesn't outlive the
+ * insert. */
+#define HTAB_INITIAL_SIZE 64
+typedef struct
+{
+  const char *key;
+  size_t size;
+  u64 hash;
+  word value;
+} htab_entry_t;
+
+typedef struct
+{
+  htab_entry_t *entries;
+  size_t used, capacity;
+  arena_t keys;
+} htab_t;
+
+// FNV-1a
+u64 hash_bytes(const void *, size_t);
+
+void htab_init(htab_t *, size_t initial_size);
+void htab_free(htab_t *);
+// Returns false, leaving the table as is, if the key is already in it
+bool htab_insert(htab_t *, const char *key, size_t size, word value);
+bool htab_get(htab_t *, const char *key, size_t size, word *value);
+
+/* Monotonic clock in nanoseconds, for timing */
+u64 time_now_ns(void);
+
 #endif
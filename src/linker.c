@@ -0,0 +1,99 @@
+/* linker.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Links relocatable objects into bytecode
+ */
+
+#include "./lib.h"
+#include "./object.h"
+#include "./parser.h"
+#include "./vm.h"
+
+#include <errno.h>
+#include <string.h>
+
+void usage(FILE *fp)
+{
+  fputs("./linker.out [OUTPUT] [OBJECT]...\n"
+        "\tLink OBJECTs (made by assembler.out -c) into bytecode, stored at "
+        "OUTPUT\n"
+        "\tOUTPUT: File name for bytecode storage (will be overwritten)\n"
+        "\tOBJECT: Object files, in the order their code is laid out: "
+        "execution starts at the first\n",
+        fp);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 3)
+  {
+    usage(stderr);
+    return 1;
+  }
+
+  const char *out_name = argv[1];
+  size_t count         = argc - 2;
+  emitter_t *objects   = calloc(count, sizeof(*objects));
+  darr_t program       = {0};
+  vm_t vm              = {0};
+  int ret              = 0;
+  size_t read          = 0;
+
+  for (; read < count; ++read)
+  {
+    const char *name = argv[read + 2];
+    FILE *fp         = fopen(name, "rb");
+    if (!fp)
+    {
+      fprintf(stderr,
+              "[" TERM_RED "ERROR" TERM_RESET
+              "]: Could not read file `%s`: %s\n",
+              name, strerror(errno));
+      ret = 1;
+      goto end;
+    }
+    buffer_t buffer = buffer_read_file(name, fp);
+    fclose(fp);
+    bool ok = object_read(objects + read, &buffer);
+    free(buffer.data);
+    if (!ok)
+    {
+      fprintf(stderr,
+              "[" TERM_RED "ERROR" TERM_RESET "]: `%s` is not an object\n",
+              name);
+      ret = 1;
+      goto end;
+    }
+  }
+
+  link_error_t error = {0};
+  perr_t perr        = emitter_link(objects, count, &program, &error);
+  if (perr != PERR_OK)
+  {
+    fprintf(stderr, "%s: %s `%.*s`\n", argv[error.emitter + 2],
+            perr_as_cstr(perr), (int)error.size, error.name);
+    ret = 255 - perr;
+    goto end;
+  }
+
+  FILE *fp = fopen(out_name, "wb");
+  if (!fp)
+  {
+    fprintf(stderr,
+            "[" TERM_RED "ERROR" TERM_RESET "]: Could not open file `%s`: %s\n",
+            out_name, strerror(errno));
+    ret = 1;
+    goto end;
+  }
+  vm_copy_program(&vm, program.data, program.used);
+  vm_write_program(&vm, fp);
+  fclose(fp);
+
+end:
+  for (size_t i = 0; i < read; ++i)
+    emitter_free(objects + i);
+  free(objects);
+  darr_free(&program);
+  vm_free(&vm);
+  return ret;
+}
@@ -0,0 +1,34 @@
+/* object.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Relocatable object files
+ */
+
+#include "./object.h"
+
+#include <string.h>
+
+void object_write(emitter_t *emitter, FILE *fp)
+{
+  word version = OBJECT_VERSION;
+  fwrite(OBJECT_MAGIC, 1, sizeof(OBJECT_MAGIC) - 1, fp);
+  fwrite(&version, sizeof(version), 1, fp);
+  emitter_write(emitter, fp);
+}
+
+bool object_read(emitter_t *emitter, buffer_t *buffer)
+{
+  const size_t magic = sizeof(OBJECT_MAGIC) - 1;
+  word version       = 0;
+  bool ok            = buffer_space_left(*buffer) > magic;
+  ok = ok && memcmp(buffer->data + buffer->cur, OBJECT_MAGIC, magic) == 0;
+  buffer->cur += magic;
+  ok = ok && emitter_read_word(buffer, &version) && version == OBJECT_VERSION;
+  if (!ok)
+  {
+    // emitter_read leaves it freed on failure, so do the same
+    *emitter = (emitter_t){0};
+    return false;
+  }
+  return emitter_read(emitter, buffer);
+}
@@ -0,0 +1,23 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "./lib.h"
+#include "./parser.h"
+
+/* Relocatable object files: one resolved emitter (see emitter_write)
+ * after a header.  The emitter's labels are the symbols an object
+ * exports, its fixups are the symbols it imports and its relocations
+ * are every operand holding an address within it: label jumps, `push
+ * *N` and relative jumps.  linker.out links objects in the order given,
+ * so the first instruction of the first object is the entry point.
+ * Absolute jumps (`jmp N`) are left as they are, so refer to addresses
+ * in the linked program. */
+#define OBJECT_MAGIC   "SVMOBJCT"
+#define OBJECT_VERSION 1
+
+void object_write(emitter_t *, FILE *);
+// Returns false, leaving the emitter freed, if the buffer isn't an
+// object or is malformed
+bool object_read(emitter_t *, buffer_t *);
+
+#endif
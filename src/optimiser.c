@@ -0,0 +1,601 @@
+/* optimiser.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Optimisation passes over assembled programs
+ */
+
+#include "./optimiser.h"
+#include "./cfg.h"
+#include "./vm.h"
+
+bool optimiser_address(op_t op, bool relocated, size_t size, size_t *address)
+{
+  if ((op.opcode != OP_JUMP && !(op.opcode == OP_PUSH && relocated)) ||
+      data_type(op.operand) != DATA_UINT || data_as_uint(op.operand) > size)
+    return false;
+  *address = data_as_uint(op.operand);
+  return true;
+}
+
+bool *optimiser_relocated(emitter_t *emitter)
+{
+  bool *relocated = calloc(emitter->program.used + 1, sizeof(*relocated));
+  for (size_t i = 0; i < emitter->relocations.used; ++i)
+    relocated[DARR_MEMBER(&emitter->relocations, size_t, i)] = true;
+  return relocated;
+}
+
+bool *optimiser_targets(emitter_t *emitter, const bool *relocated)
+{
+  size_t size   = emitter->program.used;
+  op_t *program = emitter->program.data;
+  bool *targets = calloc(size + 1, sizeof(*targets));
+  for (size_t i = 0, address = 0; i < size; ++i)
+    if (optimiser_address(program[i], relocated[i], size, &address))
+      targets[address] = true;
+  return targets;
+}
+
+size_t optimiser_compact(emitter_t *emitter, const bool *removed)
+{
+  size_t size     = emitter->program.used;
+  op_t *program   = emitter->program.data;
+  bool *relocated = optimiser_relocated(emitter);
+
+  // New address of every instruction, where a removed instruction
+  // becomes the next one kept
+  size_t *map = calloc(size + 1, sizeof(*map));
+  size_t kept = 0;
+  for (size_t i = 0; i < size; ++i)
+  {
+    map[i] = kept;
+    if (!removed[i])
+      ++kept;
+  }
+  map[size] = kept;
+
+  for (size_t i = 0, j = 0, address = 0; i < size; ++i)
+  {
+    if (removed[i])
+      continue;
+    op_t op = program[i];
+    if (optimiser_address(op, relocated[i], size, &address))
+      op.operand = data_uint(map[address]);
+    program[j++] = op;
+  }
+  emitter->program.used = kept;
+
+  size_t *relocations = emitter->relocations.data, left = 0;
+  for (size_t i = 0; i < emitter->relocations.used; ++i)
+    if (!removed[relocations[i]])
+      relocations[left++] = map[relocations[i]];
+  emitter->relocations.used = left;
+
+  for (size_t i = 0; i < emitter->labels.capacity; ++i)
+  {
+    htab_entry_t *entry = emitter->labels.entries + i;
+    if (entry->key && entry->value <= size)
+      entry->value = map[entry->value];
+  }
+
+  free(map);
+  free(relocated);
+  return size - kept;
+}
+
+// One round of the peephole optimiser, marking what it deletes in
+// removed.  Returns whether it found anything.
+bool optimiser_peephole_round(emitter_t *emitter, bool *removed)
+{
+  size_t size     = emitter->program.used;
+  op_t *program   = emitter->program.data;
+  bool *relocated = optimiser_relocated(emitter);
+  bool *targets   = optimiser_targets(emitter, relocated);
+  // Instructions kept so far, so a pop can see past deleted pairs to
+  // the push before them (i.e. `push a; push b; pop; pop`)
+  size_t *kept = calloc(size + 1, sizeof(*kept)), kept_size = 0;
+  // Jumps to a removed instruction land on the next one kept
+  bool landed  = false;
+  bool changed = false;
+
+  for (size_t i = 0, address = 0; i < size; ++i)
+  {
+    op_t op     = program[i];
+    bool target = targets[i] || landed;
+    bool remove = op.opcode == OP_NONE;
+    if (op.opcode == OP_JUMP &&
+        optimiser_address(op, relocated[i], size, &address))
+      remove = address == i + 1;
+    else if (op.opcode == OP_POP && !target && kept_size > 0)
+    {
+      size_t prev = kept[kept_size - 1];
+      if (program[prev].opcode == OP_PUSH || program[prev].opcode == OP_DUP)
+      {
+        --kept_size;
+        removed[prev] = true;
+        remove        = true;
+        // Whatever jumped to the push now lands after the pop
+        target = targets[prev] || target;
+      }
+    }
+
+    if (remove)
+    {
+      removed[i] = true;
+      landed     = target;
+      changed    = true;
+    }
+    else
+    {
+      kept[kept_size++] = i;
+      targets[i]        = target;
+      landed            = false;
+    }
+  }
+
+  free(kept);
+  free(targets);
+  free(relocated);
+  return changed;
+}
+
+size_t optimiser_peephole(emitter_t *emitter)
+{
+  // Each round may leave new pairs behind, i.e. a jump over the
+  // instructions it just deleted
+  size_t removed_total = 0;
+  for (bool changed = true; changed;)
+  {
+    bool *removed = calloc(emitter->program.used + 1, sizeof(*removed));
+    changed       = optimiser_peephole_round(emitter, removed);
+    if (changed)
+      removed_total += optimiser_compact(emitter, removed);
+    free(removed);
+  }
+  return removed_total;
+}
+
+typedef struct
+{
+  bool known;
+  data_t *value;
+  // Instruction which pushed it
+  size_t producer;
+} fold_value_t;
+
+// Whether vm_plus or vm_mult can safely run on a and b here, giving
+// the same result as at runtime
+bool optimiser_foldable(inst_t opcode, data_t *a, data_t *b)
+{
+  // data_as_float doesn't undo data_float, so a float folded here (then
+  // written out) wouldn't match one computed at runtime
+  data_type_t a_ = data_type(a), b_ = data_type(b);
+  if ((a_ != DATA_INT && a_ != DATA_UINT) ||
+      (b_ != DATA_INT && b_ != DATA_UINT))
+    return false;
+  // vm_mult divides by a uint a
+  else if (opcode == OP_MULT && a_ == DATA_UINT && b_ == DATA_UINT &&
+           data_as_uint(a) == 0)
+    return false;
+
+  // data_int and data_uint assert their argument is 60 bits, which
+  // vm_plus and vm_mult don't always check first, so the exact result
+  // must fit
+  i64 x = a_ == DATA_INT ? data_as_int(a) : (i64)data_as_uint(a);
+  i64 y = b_ == DATA_INT ? data_as_int(b) : (i64)data_as_uint(b);
+  i64 z = 0;
+  bool overflow = opcode == OP_PLUS ? __builtin_add_overflow(x, y, &z)
+                                    : __builtin_mul_overflow(x, y, &z);
+  return !overflow && z >= INT60_MIN && z <= INT60_MAX;
+}
+
+size_t optimiser_fold(emitter_t *emitter)
+{
+  size_t size     = emitter->program.used;
+  op_t *program   = emitter->program.data;
+  bool *relocated = optimiser_relocated(emitter);
+  bool *targets   = optimiser_targets(emitter, relocated);
+  bool *removed   = calloc(size + 1, sizeof(*removed));
+  // Instructions kept so far, as folding needs the two pushes of its
+  // operands to come just before it
+  size_t *kept = calloc(size + 1, sizeof(*kept)), kept_size = 0;
+  // The top of the stack, as far as it's known since the last leader:
+  // anything below it is unknown
+  fold_value_t *stack = calloc(VM_STACK_MAX, sizeof(*stack));
+  size_t sptr         = 0;
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    op_t op = program[i];
+    // Control may arrive here with any stack
+    if (targets[i])
+      sptr = 0;
+    fold_value_t value = {false, NULL, i};
+
+    switch (op.opcode)
+    {
+    case OP_PUSH:
+    case OP_DUP:
+      // `push *N` pushes an address, which compacting may change
+      if (op.opcode == OP_PUSH && !relocated[i])
+      {
+        value.known = true;
+        value.value = op.operand;
+      }
+      else if (op.opcode == OP_DUP && data_as_uint(op.operand) < sptr)
+      {
+        value          = stack[sptr - 1 - data_as_uint(op.operand)];
+        value.producer = i;
+      }
+      // Forget the bottom of a full stack rather than overflow
+      if (sptr == VM_STACK_MAX)
+        sptr = 0;
+      stack[sptr++] = value;
+      break;
+    case OP_POP:
+      if (sptr > 0)
+        --sptr;
+      break;
+    case OP_PLUS:
+    case OP_MULT: {
+      fold_value_t a = sptr > 1 ? stack[sptr - 2] : value;
+      fold_value_t b = sptr > 1 ? stack[sptr - 1] : value;
+      sptr           = sptr > 1 ? sptr - 2 : 0;
+
+      bool foldable = a.known && b.known && kept_size > 1;
+      foldable      = foldable && a.producer == kept[kept_size - 2];
+      foldable      = foldable && b.producer == kept[kept_size - 1];
+      // Jumping between the pushes skips the first
+      foldable = foldable && !targets[b.producer];
+      foldable = foldable && optimiser_foldable(op.opcode, a.value, b.value);
+
+      data_t *result = NULL;
+      err_t err      = ERR_ILLEGAL_INSTRUCTION;
+      if (foldable)
+        err = op.opcode == OP_PLUS ? vm_plus(a.value, b.value, &result)
+                                   : vm_mult(a.value, b.value, &result);
+      // Anything that fails at runtime must still fail there
+      if (err == ERR_OK)
+      {
+        removed[a.producer] = true;
+        removed[b.producer] = true;
+        kept_size -= 2;
+        program[i]  = OP_CREATE_PUSH(result);
+        value.known = true;
+        value.value = result;
+        // Jumps to the first push now land here
+        targets[i] = targets[a.producer];
+      }
+      stack[sptr++] = value;
+      break;
+    }
+    case OP_NONE:
+    case OP_PRINT:
+      break;
+    case OP_HALT:
+    case OP_JUMP:
+    case NUMBER_OF_OPERATORS:
+    default:
+      sptr = 0;
+      break;
+    }
+    kept[kept_size++] = i;
+  }
+
+  size_t folded = optimiser_compact(emitter, removed);
+  free(stack);
+  free(kept);
+  free(removed);
+  free(targets);
+  free(relocated);
+  return folded;
+}
+
+// Whether op is a jump to an address in the program
+bool optimiser_static_jump(op_t op, size_t size)
+{
+  return op.opcode == OP_JUMP && data_type(op.operand) == DATA_UINT &&
+         data_as_uint(op.operand) < size;
+}
+
+size_t optimiser_thread(emitter_t *emitter)
+{
+  size_t size   = emitter->program.used;
+  op_t *program = emitter->program.data;
+  // Last jump whose chain went through each instruction, to find cycles
+  size_t *seen    = calloc(size, sizeof(*seen));
+  size_t threaded = 0;
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    if (!optimiser_static_jump(program[i], size))
+      continue;
+    size_t target = data_as_uint(program[i].operand);
+    seen[i]       = i + 1;
+    while (optimiser_static_jump(program[target], size) &&
+           seen[target] != i + 1)
+    {
+      seen[target] = i + 1;
+      target       = data_as_uint(program[target].operand);
+    }
+    // A chain ending in a cycle never gets anywhere, so leave it be
+    if (seen[target] == i + 1)
+      continue;
+    else if (target != data_as_uint(program[i].operand))
+    {
+      program[i].operand = data_uint(target);
+      ++threaded;
+    }
+  }
+
+  free(seen);
+  return threaded;
+}
+
+size_t optimiser_unreachable(emitter_t *emitter)
+{
+  size_t size     = emitter->program.used;
+  op_t *program   = emitter->program.data;
+  bool *relocated = optimiser_relocated(emitter);
+  bool *reached   = calloc(size + 1, sizeof(*reached));
+  size_t *work    = calloc(size + 1, sizeof(*work)), work_size = 0;
+
+  // Execution starts at 0, and `jmp *` may go to any address pushed by
+  // `push *N`, wherever that push is
+  if (size > 0)
+    work[work_size++] = 0;
+  for (size_t i = 0, address = 0; i < size; ++i)
+    if (program[i].opcode == OP_PUSH &&
+        optimiser_address(program[i], relocated[i], size, &address))
+      work[work_size++] = address;
+
+  while (work_size > 0)
+  {
+    size_t i = work[--work_size];
+    for (; i < size && !reached[i]; ++i)
+    {
+      reached[i] = true;
+      op_t op    = program[i];
+      if (op.opcode == OP_HALT)
+        break;
+      else if (op.opcode == OP_JUMP)
+      {
+        // `jmp *` only goes to the pushed addresses above
+        if (optimiser_static_jump(op, size))
+          work[work_size++] = data_as_uint(op.operand);
+        break;
+      }
+    }
+  }
+
+  bool *removed = calloc(size + 1, sizeof(*removed));
+  for (size_t i = 0; i < size; ++i)
+    removed[i] = !reached[i];
+  size_t unreachable = optimiser_compact(emitter, removed);
+
+  free(removed);
+  free(work);
+  free(reached);
+  free(relocated);
+  return unreachable;
+}
+
+size_t optimiser_run(emitter_t *emitter, optimiser_stats_t *stats)
+{
+  // Each pass may leave work for the others, i.e. folding `push 1; push
+  // 2; plus; pop` leaves a push and pop behind
+  for (size_t changed = 1; changed > 0;)
+  {
+    size_t peephole    = optimiser_peephole(emitter);
+    size_t folded      = optimiser_fold(emitter);
+    size_t threaded    = optimiser_thread(emitter);
+    size_t unreachable = optimiser_unreachable(emitter);
+    stats->peephole += peephole;
+    stats->folded += folded;
+    stats->threaded += threaded;
+    stats->unreachable += unreachable;
+    changed = peephole + folded + threaded + unreachable;
+  }
+  return stats->peephole + stats->folded + stats->unreachable;
+}
+
+typedef struct
+{
+  size_t block;
+  u64 count;
+} optimiser_link_t;
+
+// Hottest first, then in program order
+int optimiser_link_cmp(const void *a, const void *b)
+{
+  const optimiser_link_t *x = a, *y = b;
+  if (x->count != y->count)
+    return x->count > y->count ? -1 : 1;
+  return x->block < y->block ? -1 : x->block > y->block;
+}
+
+/* Chains blocks greedily along their successor edges, hottest first
+ * (after Pettis and Hansen), into order.  Each block has at most one
+ * successor so this is just which predecessor gets to fall through
+ * into each block.  Returns the number of blocks in cold chains. */
+size_t optimiser_layout_order(cfg_t *cfg, const op_t *program,
+                              const u64 *block_counts, const u64 *jump_counts,
+                              size_t *order)
+{
+  size_t blocks = cfg->blocks, links_size = 0, chains_size = 0, cold = 0;
+  size_t *next  = calloc(blocks + 1, sizeof(*next));
+  size_t *prev  = calloc(blocks + 1, sizeof(*prev));
+  // The other end of a chain, for its head and its tail
+  size_t *end             = calloc(blocks + 1, sizeof(*end));
+  optimiser_link_t *links = calloc(blocks + 1, sizeof(*links));
+  for (size_t b = 0; b < blocks; ++b)
+  {
+    next[b] = CFG_NONE;
+    prev[b] = CFG_NONE;
+    end[b]  = b;
+  }
+
+  for (size_t b = 0; b < blocks; ++b)
+  {
+    if (cfg->succ_start[b] == cfg->succ_start[b + 1])
+      continue;
+    size_t s = cfg->succs[cfg->succ_start[b]], last = cfg->leaders[b + 1] - 1;
+    u64 count = program[last].opcode == OP_JUMP
+                    ? jump_counts[last]
+                    : block_counts[cfg->leaders[b]];
+    // Code never run keeps its own fall throughs, so it doesn't need
+    // jumps inserted
+    bool never_run = block_counts[cfg->leaders[b]] == 0 &&
+                     block_counts[cfg->leaders[s]] == 0 && s == b + 1;
+    // Nothing may come before the entry point
+    if (s != 0 && s != b && (count > 0 || never_run))
+      links[links_size++] = (optimiser_link_t){b, count};
+  }
+  qsort(links, links_size, sizeof(*links), optimiser_link_cmp);
+
+  for (size_t i = 0; i < links_size; ++i)
+  {
+    size_t b = links[i].block, s = cfg->succs[cfg->succ_start[b]];
+    // b must end one chain and s start another
+    if (next[b] != CFG_NONE || prev[s] != CFG_NONE || end[s] == b)
+      continue;
+    size_t head = end[b], tail = end[s];
+    next[b]     = s;
+    prev[s]     = b;
+    end[head]   = tail;
+    end[tail]   = head;
+  }
+
+  // Chains after the entry point's by their hottest block
+  optimiser_link_t *chains = links;
+  for (size_t b = 1; b < blocks; ++b)
+  {
+    if (prev[b] != CFG_NONE)
+      continue;
+    u64 heat = 0;
+    for (size_t c = b; c != CFG_NONE; c = next[c])
+      heat = MAX(heat, block_counts[cfg->leaders[c]]);
+    chains[chains_size++] = (optimiser_link_t){b, heat};
+  }
+  qsort(chains, chains_size, sizeof(*chains), optimiser_link_cmp);
+
+  size_t placed = 0;
+  for (size_t c = 0; c != CFG_NONE; c = next[c])
+    order[placed++] = c;
+  for (size_t i = 0; i < chains_size; ++i)
+    for (size_t c = chains[i].block; c != CFG_NONE; c = next[c])
+    {
+      order[placed++] = c;
+      cold += chains[i].count == 0;
+    }
+
+  free(links);
+  free(end);
+  free(prev);
+  free(next);
+  return cold;
+}
+
+void optimiser_layout(emitter_t *emitter, const u64 *block_counts,
+                      const u64 *jump_counts, optimiser_layout_t *stats)
+{
+  size_t size     = emitter->program.used;
+  op_t *program   = emitter->program.data;
+  bool *relocated = optimiser_relocated(emitter);
+  for (size_t i = 0; i < size; ++i)
+    stats->taken_before += jump_counts[i];
+  if (size == 0)
+  {
+    free(relocated);
+    return;
+  }
+
+  cfg_t cfg = {0};
+  cfg_init(&cfg, program, size, relocated);
+  size_t blocks = cfg.blocks;
+  size_t *order = calloc(blocks + 1, sizeof(*order));
+  stats->cold   = optimiser_layout_order(&cfg, program, block_counts,
+                                         jump_counts, order);
+
+  // New address of every instruction, where a deleted jump becomes the
+  // start of the block after it (its target)
+  size_t *where = calloc(size + 1, sizeof(*where));
+  bool *removed = calloc(size + 1, sizeof(*removed));
+  bool *jumps   = calloc(blocks + 1, sizeof(*jumps));
+  size_t at     = 0;
+  for (size_t k = 0; k < blocks; ++k)
+  {
+    size_t b = order[k], last = cfg.leaders[b + 1] - 1;
+    // The end of the program counts as the block after the last one
+    word following = k + 1 < blocks ? cfg.leaders[order[k + 1]] : size;
+    for (size_t i = cfg.leaders[b]; i <= last; ++i)
+      where[i] = at++;
+
+    op_t op = program[last];
+    if (optimiser_static_jump(op, size) &&
+        data_as_uint(op.operand) == following)
+    {
+      removed[last] = true;
+      where[last]   = --at;
+      ++stats->deleted;
+    }
+    else if (op.opcode != OP_JUMP && op.opcode != OP_HALT &&
+             cfg.leaders[b + 1] != following)
+    {
+      jumps[b] = true;
+      ++at;
+      ++stats->inserted;
+      stats->taken_after += block_counts[cfg.leaders[b]];
+    }
+    if (op.opcode == OP_JUMP && !removed[last])
+      stats->taken_after += jump_counts[last];
+  }
+  where[size] = at;
+
+  darr_t laid_out = {0};
+  bool *moved     = calloc(at + 1, sizeof(*moved));
+  darr_init(&laid_out, at + 1, sizeof(op_t));
+  for (size_t k = 0; k < blocks; ++k)
+  {
+    size_t b = order[k];
+    for (size_t i = cfg.leaders[b], address = 0; i < cfg.leaders[b + 1]; ++i)
+    {
+      if (removed[i])
+        continue;
+      op_t op = program[i];
+      if (optimiser_address(op, relocated[i], size, &address))
+        op.operand = data_uint(where[address]);
+      moved[laid_out.used] = relocated[i];
+      DARR_APP(&laid_out, op_t, op);
+    }
+    if (jumps[b])
+    {
+      moved[laid_out.used] = true;
+      DARR_APP(&laid_out, op_t,
+               OP_CREATE_JMP(data_uint(where[cfg.leaders[b + 1]])));
+    }
+  }
+  darr_free(&emitter->program);
+  emitter->program = laid_out;
+
+  // Relocations in address order, as the emitter makes them
+  emitter->relocations.used = 0;
+  for (size_t i = 0; i < at; ++i)
+    if (moved[i])
+      DARR_APP(&emitter->relocations, size_t, i);
+
+  for (size_t i = 0; i < emitter->labels.capacity; ++i)
+  {
+    htab_entry_t *entry = emitter->labels.entries + i;
+    if (entry->key && entry->value <= size)
+      entry->value = where[entry->value];
+  }
+
+  free(moved);
+  free(jumps);
+  free(removed);
+  free(where);
+  free(order);
+  cfg_free(&cfg);
+  free(relocated);
+}
@@ -0,0 +1,95 @@
+#ifndef OPTIMISER_H
+#define OPTIMISER_H
+
+#include "./lib.h"
+#include "./parser.h"
+
+/* Optimisation passes over the program of a finished emitter (see
+ * emitter_finish), i.e. one with no fixups left.  Instructions holding
+ * an address are the jumps with a uint operand and the pushes recorded
+ * as relocations (`push *N`); every pass keeps those, along with the
+ * emitter's relocations and labels, pointing at the same code.  A uint
+ * pushed as a literal is never treated as an address, so a program
+ * which computes the target of `jmp *` some other way may break. */
+
+/* Peephole optimiser: repeatedly deletes noops, `push x; pop`, `dup N;
+ * pop` and jumps to the next instruction until there are none left.
+ * A pair is only deleted if nothing jumps to the pop, and any stack
+ * overflow or underflow it would have caused goes with it.  Returns the
+ * number of instructions removed. */
+size_t optimiser_peephole(emitter_t *);
+
+/* Constant folding: interprets each straight line run of code (from
+ * one jump target, jump or halt to the next) on a stack of the values
+ * known at assembly time, from pushes and duplicates of them.  Where
+ * both operands of a plus or mult are known and pushed by the two
+ * instructions just before it, all three become a push of the result,
+ * computed by vm_plus or vm_mult.  If that would fail (i.e. integer
+ * overflow) the instructions are left for the same error at runtime,
+ * as is anything involving a float.
+ * Returns the number of instructions removed. */
+size_t optimiser_fold(emitter_t *);
+
+/* Jump threading: retargets every jump to a jump straight to where the
+ * chain of jumps ends, so `jmp a` then `label a; jmp b` costs one
+ * dispatch.  Chains ending in a cycle are left alone.  Returns the
+ * number of jumps retargeted. */
+size_t optimiser_thread(emitter_t *);
+
+/* Unreachable code elimination: deletes every instruction which can't
+ * be reached from the start of the program or from any address pushed
+ * by `push *N`, following static jumps and falling through everything
+ * else but halt.  `jmp *` is assumed to go to any of those pushed
+ * addresses.  Returns the number of instructions removed. */
+size_t optimiser_unreachable(emitter_t *);
+
+typedef struct
+{
+  // Instructions removed by each pass
+  size_t peephole, folded, unreachable;
+  // Jumps retargeted by threading
+  size_t threaded;
+} optimiser_stats_t;
+
+// Run every pass until none of them find anything, adding what each
+// removed to stats.  Returns the number of instructions removed.
+size_t optimiser_run(emitter_t *, optimiser_stats_t *);
+
+typedef struct
+{
+  // Jumps taken on the profiled run, and as estimated for the new layout
+  u64 taken_before, taken_after;
+  // Jumps deleted as their target now follows them, and jumps inserted
+  // where a block no longer falls through to the next
+  size_t deleted, inserted;
+  // Blocks never entered on the profiled run, placed last
+  size_t cold;
+} optimiser_layout_t;
+
+/* Profile guided block layout: reorders the basic blocks (see cfg.h)
+ * so that the hottest jumps become fall throughs, the program's entry
+ * point staying first, then places the hot chains of blocks by how hot
+ * they are and everything never entered after them.  block_counts and
+ * jump_counts are from profile_read on the program as it is now.
+ * Jumps to the block placed next are deleted and blocks which fell
+ * through to one placed elsewhere get a jump to it, so the program
+ * does the same thing in fewer taken jumps. */
+void optimiser_layout(emitter_t *, const u64 *block_counts,
+                      const u64 *jump_counts, optimiser_layout_t *);
+
+/* Delete every instruction marked in removed (one per instruction),
+ * then rewrite every address so it points at the same instruction, or
+ * the next one kept if it was removed.  Returns the number of
+ * instructions removed. */
+size_t optimiser_compact(emitter_t *, const bool *removed);
+
+// Whether the instruction at address holds an address; relocated is
+// whether it's one of the emitter's relocations
+bool optimiser_address(op_t, bool relocated, size_t size, size_t *address);
+// One flag per instruction, set for each of the emitter's relocations
+bool *optimiser_relocated(emitter_t *);
+// One flag per instruction (and the end of the program), set for each
+// address some instruction holds
+bool *optimiser_targets(emitter_t *, const bool *relocated);
+
+#endif
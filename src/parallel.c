@@ -0,0 +1,106 @@
+/* parallel.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Data-parallel assembly of large sources
+ */
+
+// For sysconf
+#define _DEFAULT_SOURCE
+
+#include "./parallel.h"
+#include "./lexer.h"
+#include "./parser.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct
+{
+  buffer_t view;
+  emitter_t emitter;
+  bool ok;
+} chunk_t;
+
+size_t parallel_jobs(void)
+{
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return online < 1 ? 1 : MIN((size_t)online, PARALLEL_MAX_JOBS);
+}
+
+// Size of the chunk starting at start: at least size bytes, ending
+// after a newline unless it's the rest of the buffer
+size_t parallel_chunk_size(buffer_t *buffer, size_t start, size_t size)
+{
+  const char *data = buffer->data;
+  size_t end       = start + size;
+  // A newline may only be inside a token as a character literal, so
+  // don't split after one which may end up in a literal
+  for (; end < buffer->available; ++end)
+    if (data[end - 1] == '\n' && data[end - 2] != '\'' && data[end] != '\'')
+      break;
+  return MIN(end, buffer->available) - start;
+}
+
+void *parallel_chunk(void *arg)
+{
+  chunk_t *chunk = arg;
+  chunk->ok      = emitter_assemble(&chunk->emitter, &chunk->view);
+  return NULL;
+}
+
+bool parallel_assemble(buffer_t *buffer, size_t jobs, op_t **instructions,
+                       u64 *instructions_size)
+{
+  jobs = MIN(MIN(jobs, PARALLEL_MAX_JOBS),
+             buffer->available / PARALLEL_MIN_CHUNK);
+  if (jobs < 2)
+    return false;
+
+  chunk_t chunks[PARALLEL_MAX_JOBS] = {0};
+  pthread_t threads[PARALLEL_MAX_JOBS];
+  bool started[PARALLEL_MAX_JOBS] = {0};
+  size_t count = 0, per_chunk = buffer->available / jobs;
+  for (size_t start = 0; start < buffer->available; ++count)
+  {
+    // The last chunk takes whatever is left
+    size_t size = count == jobs - 1
+                      ? buffer->available - start
+                      : parallel_chunk_size(buffer, start, per_chunk);
+    chunks[count].view = (buffer_t){.name      = buffer->name,
+                                    .data      = buffer->data + start,
+                                    .available = size};
+    start += size;
+  }
+
+  for (size_t i = 0; i < count; ++i)
+    started[i] =
+        pthread_create(threads + i, NULL, parallel_chunk, chunks + i) == 0;
+  // Anything that couldn't get a thread is done on this one
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      parallel_chunk(chunks + i);
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < count; ++i)
+    ok = ok && chunks[i].ok;
+
+  emitter_t emitters[PARALLEL_MAX_JOBS] = {0};
+  for (size_t i = 0; i < count; ++i)
+    emitters[i] = chunks[i].emitter;
+  darr_t program = {0};
+  if (ok && emitter_link(emitters, count, &program, NULL) == PERR_OK)
+  {
+    *instructions      = program.data;
+    *instructions_size = program.used;
+  }
+  else
+    ok = false;
+
+  for (size_t i = 0; i < count; ++i)
+    emitter_free(&chunks[i].emitter);
+  return ok;
+}
@@ -0,0 +1,29 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "./lib.h"
+#include "./op.h"
+
+/* Data-parallel assembly of a source in memory: the source is split
+ * at line boundaries into chunks, each chunk is lexed and parsed into
+ * its own emitter on its own thread and the emitters are then linked
+ * into one program.
+ *
+ * Chunks know nothing of each other, so the few programs which parse
+ * differently in pieces (e.g. a relative jump before the start of its
+ * chunk) fail here.  Any failure, including ordinary errors in the
+ * source, just means the caller should assemble sequentially, which
+ * also gives errors their positions. */
+
+// Chunks smaller than this aren't worth a thread
+#define PARALLEL_MIN_CHUNK (1 << 18)
+#define PARALLEL_MAX_JOBS  64
+
+// Number of jobs to use by default: the number of online processors
+size_t parallel_jobs(void);
+
+// Returns false if the buffer should be assembled sequentially instead
+bool parallel_assemble(buffer_t *, size_t jobs, op_t **instructions,
+                       u64 *instructions_size);
+
+#endif
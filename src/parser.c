@@ -8,7 +8,6 @@
 
 #include <assert.h>
 #include <ctype.h>
-#include <errno.h>
 #include <limits.h>
 #include <math.h>
 #include <stdio.h>
@@ -16,12 +15,11 @@
 
 perr_t parse_nil(stream_t *stream, data_t **datum)
 {
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
 
   token_t token = stream_pop(stream);
-  if (!(token.type == TOKEN_SYMBOL && token.size == 3 &&
-        strncmp(token.content, "nil", 3) == 0))
+  if (!(token.type == TOKEN_SYMBOL && token_equals(stream, token, "nil")))
   {
     stream->cursor--;
     return PERR_EXPECTED_NIL;
@@ -32,7 +30,7 @@ perr_t parse_nil(stream_t *stream, data_t **datum)
 
 perr_t parse_bool(stream_t *stream, data_t **datum)
 {
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
 
   token_t token = stream_peek(stream);
@@ -47,13 +45,13 @@ perr_t parse_bool(stream_t *stream, data_t **datum)
   }
   else if (token.type == TOKEN_SYMBOL)
   {
-    if (token.size == 4 && strncmp(token.content, "true", 4) == 0)
+    if (token_equals(stream, token, "true"))
     {
       stream_pop(stream);
       *datum = data_bool(true);
       return PERR_OK;
     }
-    else if (token.size == 5 && strncmp(token.content, "false", 5) == 0)
+    else if (token_equals(stream, token, "false"))
     {
       stream_pop(stream);
       *datum = data_bool(false);
@@ -65,7 +63,7 @@ perr_t parse_bool(stream_t *stream, data_t **datum)
 
 perr_t parse_char(stream_t *stream, data_t **datum)
 {
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
 
   token_t token = stream_peek(stream);
@@ -85,7 +83,7 @@ perr_t parse_char(stream_t *stream, data_t **datum)
   else if (token.type == TOKEN_CHARACTER)
   {
     stream_pop(stream);
-    *datum = data_char(token.content[0]);
+    *datum = data_char(token_as_char(stream, token));
     return PERR_OK;
   }
   return PERR_EXPECTED_CHAR;
@@ -93,87 +91,77 @@ perr_t parse_char(stream_t *stream, data_t **datum)
 
 perr_t parse_i64(stream_t *stream, data_t **datum)
 {
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
 
-  token_t token = stream_peek(stream);
-  if (token.type != TOKEN_NUMBER)
+  token_t token   = stream_peek(stream);
+  number_t number = token.number;
+  if (token.type != TOKEN_NUMBER || (number.flags & NUMBER_POINT))
     return PERR_EXPECTED_INTEGER;
 
-  char *end  = NULL;
-  i64 parsed = strtoll(token.content, &end, 10);
-
-  if (((u64)(end - token.content)) < token.size)
-    return PERR_EXPECTED_INTEGER;
-  else if (parsed < INT60_MIN)
+  bool negative = number.flags & NUMBER_NEGATIVE;
+  bool overflow = number.flags & NUMBER_OVERFLOW;
+  if (negative && (overflow || number.integer > (u64)-INT60_MIN))
     return PERR_INTEGER_UNDERFLOW;
-  else if (parsed > INT60_MAX)
+  else if (!negative && (overflow || number.integer > INT60_MAX))
     return PERR_INTEGER_OVERFLOW;
 
   stream_pop(stream);
-  *datum = data_int(parsed);
+  *datum = data_int(negative ? -(i64)number.integer : (i64)number.integer);
   return PERR_OK;
 }
 
 perr_t parse_u64(stream_t *stream, data_t **datum)
 {
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
 
-  token_t token = stream_peek(stream);
-  if (token.type != TOKEN_NUMBER || token.content[0] == '-')
-    return PERR_EXPECTED_UINTEGER;
-
-  char *end  = NULL;
-  u64 parsed = strtoul(token.content, &end, 10);
-
-  if (((u64)(end - token.content)) < token.size)
+  token_t token   = stream_peek(stream);
+  number_t number = token.number;
+  if (token.type != TOKEN_NUMBER ||
+      (number.flags & (NUMBER_NEGATIVE | NUMBER_POINT)))
     return PERR_EXPECTED_UINTEGER;
-  else if (errno == ERANGE)
+  else if ((number.flags & NUMBER_OVERFLOW) || number.integer > UINT60_MAX)
     return PERR_UINTEGER_OVERFLOW;
 
   stream_pop(stream);
-  *datum = data_uint(parsed);
+  *datum = data_uint(number.integer);
   return PERR_OK;
 }
 
 perr_t parse_float(stream_t *stream, data_t **datum)
 {
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
 
-  token_t token = stream_peek(stream);
+  token_t token   = stream_peek(stream);
+  number_t number = token.number;
   if (token.type != TOKEN_NUMBER)
     return PERR_EXPECTED_FLOAT;
-
-  char *end    = NULL;
-  float parsed = strtof(token.content, &end);
-
-  if (((u64)(end - token.content)) < token.size)
-    return PERR_EXPECTED_FLOAT;
-  else if (errno == ERANGE)
+  else if (number.flags & NUMBER_RANGE)
   {
-    if (parsed == HUGE_VALF)
+    if (number.real == HUGE_VALF)
       return PERR_FLOAT_OVERFLOW;
     else
       return PERR_FLOAT_UNDERFLOW;
   }
 
   stream_pop(stream);
-  *datum = data_float(parsed);
+  *datum = data_float(number.flags & NUMBER_NEGATIVE ? -number.real
+                                                     : number.real);
   return PERR_OK;
 }
 
 perr_t parse_number(stream_t *stream, data_t **datum)
 {
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
 
   token_t token = stream_peek(stream);
   if (token.type != TOKEN_NUMBER)
     return PERR_EXPECTED_NUMBER;
 
-  if (strchr(token.content, '.'))
+  if (token.number.flags & NUMBER_POINT)
     return parse_float(stream, datum);
   perr_t perr = parse_i64(stream, datum);
   if (perr == PERR_INTEGER_OVERFLOW)
@@ -184,7 +172,7 @@ perr_t parse_number(stream_t *stream, data_t **datum)
 perr_t parse_push(stream_t *stream, pres_t *res)
 {
   // check eof
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
   // Assume we're at an operand
   token_t token = stream_peek(stream);
@@ -197,7 +185,8 @@ perr_t parse_push(stream_t *stream, pres_t *res)
     return parse_char(stream, &res->immediate.operand);
   else if (token.type == TOKEN_SYMBOL)
   {
-    if (token.content[0] == 't' || token.content[0] == 'f')
+    char first = token_content(stream, token)[0];
+    if (first == 't' || first == 'f')
       return parse_bool(stream, &res->immediate.operand);
     return parse_nil(stream, &res->immediate.operand);
   }
@@ -216,7 +205,7 @@ perr_t parse_push(stream_t *stream, pres_t *res)
 perr_t parse_dup(stream_t *stream, pres_t *res)
 {
   // check eof
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
   // Assume we're at an operand
   token_t token = stream_peek(stream);
@@ -230,7 +219,7 @@ perr_t parse_dup(stream_t *stream, pres_t *res)
 perr_t parse_label(stream_t *stream, pres_t *res)
 {
   // check eof
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
   // Assume we're at an operand
   token_t token = stream_peek(stream);
@@ -238,14 +227,15 @@ perr_t parse_label(stream_t *stream, pres_t *res)
     return PERR_EXPECTED_LABEL;
   stream_pop(stream);
   res->type       = PRES_LABEL;
-  res->label_name = token.content;
+  res->label.name = stream_intern(stream, token);
+  res->label.size = token.size;
   return PERR_OK;
 }
 
 perr_t parse_jmp(stream_t *stream, pres_t *res)
 {
   // check eof
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
   // Assume we're at an operand
   token_t token = stream_peek(stream);
@@ -276,13 +266,45 @@ perr_t parse_jmp(stream_t *stream, pres_t *res)
   {
     stream_pop(stream);
     res->type       = PRES_JUMP_LABEL;
-    res->label_name = token.content;
+    res->label.name = stream_intern(stream, token);
+    res->label.size = token.size;
     return PERR_OK;
   }
 
   return PERR_UNEXPECTED_OPERAND;
 }
 
+#define MNEMONIC(NAME, FIRST, SECOND, OPCODE, PARSE)                        \
+  [PARSER_MNEMONIC_HASH(sizeof(NAME) - 1, FIRST, SECOND)] = {                \
+      NAME, sizeof(NAME) - 1, OPCODE, PARSE}
+
+const mnemonic_t PARSER_MNEMONICS[PARSER_MNEMONIC_SLOTS] = {
+    MNEMONIC("noop", 'n', 'o', OP_NONE, NULL),
+    MNEMONIC("halt", 'h', 'a', OP_HALT, NULL),
+    MNEMONIC("push", 'p', 'u', OP_PUSH, parse_push),
+    MNEMONIC("pop", 'p', 'o', OP_POP, NULL),
+    MNEMONIC("plus", 'p', 'l', OP_PLUS, NULL),
+    MNEMONIC("mult", 'm', 'u', OP_MULT, NULL),
+    MNEMONIC("dup", 'd', 'u', OP_DUP, parse_dup),
+    MNEMONIC("print", 'p', 'r', OP_PRINT, NULL),
+    MNEMONIC("label", 'l', 'a', OP_NONE, parse_label),
+    MNEMONIC("jmp", 'j', 'm', OP_JUMP, parse_jmp),
+};
+
+#undef MNEMONIC
+
+const mnemonic_t *parser_mnemonic(stream_t *stream, token_t token)
+{
+  const char *content = token_content(stream, token);
+  char second         = token.size > 1 ? content[1] : 0;
+  const mnemonic_t *mnemonic =
+      PARSER_MNEMONICS + PARSER_MNEMONIC_HASH(token.size, content[0], second);
+  if (mnemonic->size == token.size &&
+      memcmp(mnemonic->name, content, token.size) == 0)
+    return mnemonic;
+  return NULL;
+}
+
 perr_t parse_line(stream_t *stream, pres_t *res)
 {
   res->stream_cursor = stream->cursor;
@@ -290,234 +312,431 @@ perr_t parse_line(stream_t *stream, pres_t *res)
 #if DEBUG == 1
   enum BufferState state = buffer_at_end(*buf);
   printf("[" TERM_GREEN "parse_line" TERM_RESET "]: Parsing ");
-  token_print(stream->tokens[stream->cursor], stdout);
+  token_print(stream, stream_peek(stream), stdout);
   puts("");
 #endif
 
   // If at end, fail
-  if (stream->cursor >= stream->size)
+  if (stream_at_end(stream))
     return PERR_EOF;
 
   token_t token = stream_peek(stream);
-
   if (token.type != TOKEN_SYMBOL)
     return PERR_ILLEGAL_OPERATOR;
-  else if (token.size >= 4 && memcmp(token.content, "noop", 4) == 0)
-  {
-    stream_pop(stream);
-    res->type             = PRES_IMMEDIATE;
-    res->immediate.opcode = OP_NONE;
-    goto NO_OPERAND;
-  }
-  else if (token.size >= 4 && memcmp(token.content, "halt", 4) == 0)
-  {
-    stream_pop(stream);
-    res->type             = PRES_IMMEDIATE;
-    res->immediate.opcode = OP_HALT;
-    goto NO_OPERAND;
-  }
-  // Type based pushes
-  else if (token.size >= 4 && memcmp(token.content, "push", 4) == 0)
+  const mnemonic_t *mnemonic = parser_mnemonic(stream, token);
+  if (!mnemonic)
+    return PERR_ILLEGAL_OPERATOR;
+
+  stream_pop(stream);
+  if (mnemonic->parse)
   {
-    stream_pop(stream);
     stream_seek_next(stream);
-    return parse_push(stream, res);
-  }
-  else if (token.size >= 3 && memcmp(token.content, "pop", 3) == 0)
-  {
-    stream_pop(stream);
-    res->type             = PRES_IMMEDIATE;
-    res->immediate.opcode = OP_POP;
-    goto NO_OPERAND;
-  }
-  else if (token.size >= 4 && memcmp(token.content, "plus", 4) == 0)
-  {
-    stream_pop(stream);
-    res->type             = PRES_IMMEDIATE;
-    res->immediate.opcode = OP_PLUS;
-    goto NO_OPERAND;
+    return mnemonic->parse(stream, res);
   }
-  else if (token.size >= 4 && memcmp(token.content, "mult", 4) == 0)
+
+  res->type              = PRES_IMMEDIATE;
+  res->immediate.opcode  = mnemonic->opcode;
+  res->immediate.operand = data_nil();
+  token                  = stream_peek(stream);
+  if (!stream_at_end(stream) &&
+      !(token.type == TOKEN_WHITESPACE || token.type == TOKEN_COMMENT))
+    return PERR_UNEXPECTED_OPERAND;
+  return PERR_OK;
+}
+
+void emitter_init(emitter_t *emitter)
+{
+  darr_init(&emitter->program, DARR_INITAL_SIZE, sizeof(op_t));
+  darr_init(&emitter->fixups, DARR_INITAL_SIZE, sizeof(fixup_t));
+  darr_init(&emitter->relocations, DARR_INITAL_SIZE, sizeof(size_t));
+  htab_init(&emitter->labels, HTAB_INITIAL_SIZE);
+  emitter->names = (arena_t){0};
+}
+
+void emitter_free(emitter_t *emitter)
+{
+  darr_free(&emitter->program);
+  darr_free(&emitter->fixups);
+  darr_free(&emitter->relocations);
+  htab_free(&emitter->labels);
+  arena_free(&emitter->names);
+}
+
+perr_t emitter_emit(emitter_t *emitter, stream_t *stream, pres_t res)
+{
+  // Address of the instruction we're about to emit
+  size_t address = emitter->program.used;
+  op_t op        = res.immediate;
+  switch (res.type)
   {
-    stream_pop(stream);
-    res->type             = PRES_IMMEDIATE;
-    res->immediate.opcode = OP_MULT;
-    goto NO_OPERAND;
-  }
-  else if (token.size >= 3 && memcmp(token.content, "dup", 3) == 0)
+  case PRES_IMMEDIATE:
+    break;
+  case PRES_LABEL:
+    // A label may only be defined once
+    if (!htab_insert(&emitter->labels, res.label.name, res.label.size,
+                     address))
+    {
+      stream->cursor = res.stream_cursor;
+      return PERR_DUPLICATE_LABEL;
+    }
+    return PERR_OK;
+  case PRES_JUMP_RELATIVE:
   {
-    stream_pop(stream);
-    stream_seek_next(stream);
-    return parse_dup(stream, res);
+    i64 abs_addr = (i64)address + data_as_int(res.operand);
+    if (abs_addr < 0)
+    {
+      stream->cursor = res.stream_cursor;
+      return PERR_ILLEGAL_INST_ADDRESS;
+    }
+    op = OP_CREATE_JMP(data_int(abs_addr));
+    DARR_APP(&emitter->relocations, size_t, address);
+    break;
   }
-  else if (token.size >= 5 && memcmp(token.content, "print", 5) == 0)
+  case PRES_JUMP_LABEL:
   {
-    stream_pop(stream);
-    res->type             = PRES_IMMEDIATE;
-    res->immediate.opcode = OP_PRINT;
-    goto NO_OPERAND;
+    word target = 0;
+    if (!htab_get(&emitter->labels, res.label.name, res.label.size, &target))
+    {
+      // Forward reference, patched by emitter_finish
+      fixup_t fixup = {address, res.stream_cursor, res.label.name,
+                       res.label.size};
+      DARR_APP(&emitter->fixups, fixup_t, fixup);
+    }
+    op = OP_CREATE_JMP(data_uint(target));
+    DARR_APP(&emitter->relocations, size_t, address);
+    break;
   }
-  else if (token.size >= 5 && memcmp(token.content, "label", 5) == 0)
+  case PRES_IPTR:
   {
-    stream_pop(stream);
-    stream_seek_next(stream);
-    return parse_label(stream, res);
+    // The operand is the address of the next instruction (plus an
+    // optional offset) as a uint
+    u64 iptr = address + 1;
+    if (data_type(op.operand) == DATA_UINT)
+      iptr += data_as_uint(op.operand);
+    op.operand = data_uint(iptr);
+    DARR_APP(&emitter->relocations, size_t, address);
+    break;
   }
-  else if (token.size >= 3 && memcmp(token.content, "jmp", 3) == 0)
-  {
-    stream_pop(stream);
-    stream_seek_next(stream);
-    return parse_jmp(stream, res);
   }
-  return PERR_ILLEGAL_OPERATOR;
-NO_OPERAND:
-  res->immediate.operand = data_nil();
-  token                  = stream_peek(stream);
-  if (stream->cursor < stream->size &&
-      !(token.type == TOKEN_WHITESPACE || token.type == TOKEN_COMMENT))
-    return PERR_UNEXPECTED_OPERAND;
+  DARR_APP(&emitter->program, op_t, op);
   return PERR_OK;
 }
 
-bool complete_cmp_string(char *a, char *b)
+size_t emitter_resolve(emitter_t *emitter)
 {
-  return strlen(a) == strlen(b) && strncmp(a, b, strlen(a)) == 0;
+  op_t *program   = emitter->program.data;
+  fixup_t *fixups = emitter->fixups.data;
+  size_t left     = 0;
+  for (size_t i = 0; i < emitter->fixups.used; ++i)
+  {
+    word target = 0;
+    if (htab_get(&emitter->labels, fixups[i].name, fixups[i].size, &target))
+      program[fixups[i].address].operand = data_uint(target);
+    else
+      // Keep the unresolved fixups in source order
+      fixups[left++] = fixups[i];
+  }
+  emitter->fixups.used = left;
+  return left;
 }
 
-perr_t process_presults(pres_t *results, size_t results_size, stream_t *stream,
-                        darr_t *output)
+perr_t emitter_finish(emitter_t *emitter, stream_t *stream)
 {
-  // Process labels and relative jumps
-  struct LabelPair
-  {
-    char *name;
-    u64 iptr;
-  };
-
-  darr_t labels       = {0};
-  size_t program_size = 0;
-  darr_init(&labels, 0, sizeof(struct LabelPair));
+  if (emitter_resolve(emitter) == 0)
+    return PERR_OK;
+  stream->cursor = DARR_MEMBER(&emitter->fixups, fixup_t, 0).stream_cursor;
+  return PERR_UNKNOWN_LABEL;
+}
 
-  for (size_t i = 0; i < results_size; ++i)
+perr_t emitter_link(emitter_t *emitters, size_t count, darr_t *program,
+                    link_error_t *error)
+{
+  size_t size = 0;
+  for (size_t i = 0; i < count; ++i)
+    size += emitters[i].program.used;
+
+  // Labels of every emitter, at their address in the linked program
+  htab_t labels = {0};
+  htab_init(&labels, HTAB_INITIAL_SIZE);
+  darr_init(program, MAX(size, 1), sizeof(op_t));
+  perr_t perr = PERR_OK;
+  for (size_t i = 0, base = 0; i < count && perr == PERR_OK; ++i)
   {
-    pres_t res = results[i];
-    // Not processing immediates or labels (yet) so just increment
-    // program_size
-    if (res.type == PRES_IMMEDIATE || res.type == PRES_JUMP_LABEL)
-      ++program_size;
-    else if (res.type == PRES_JUMP_RELATIVE)
+    htab_t *local = &emitters[i].labels;
+    for (size_t j = 0; j < local->capacity && perr == PERR_OK; ++j)
     {
-      // Get absolute program address
-      i64 addr     = data_as_int(res.operand);
-      i64 abs_addr = program_size + addr;
-      if (abs_addr < 0)
+      htab_entry_t entry = local->entries[j];
+      if (entry.key &&
+          !htab_insert(&labels, entry.key, entry.size, entry.value + base))
       {
-        darr_free(&labels);
-        return PERR_ILLEGAL_INST_ADDRESS;
+        perr = PERR_DUPLICATE_LABEL;
+        if (error)
+          *error = (link_error_t){i, entry.key, entry.size};
       }
-      (results + i)->type              = PRES_IMMEDIATE;
-      (results + i)->immediate.opcode  = OP_JUMP;
-      (results + i)->immediate.operand = data_int(abs_addr);
-      // Then register in program
-      ++program_size;
     }
-    else if (res.type == PRES_LABEL)
+    base += emitters[i].program.used;
+  }
+
+  for (size_t i = 0, base = 0; i < count && perr == PERR_OK; ++i)
+  {
+    emitter_t *emitter = emitters + i;
+    op_t *ops          = (op_t *)program->data + base;
+    memcpy(ops, emitter->program.data, emitter->program.used * sizeof(op_t));
+    program->used += emitter->program.used;
+
+    for (size_t j = 0; j < emitter->relocations.used; ++j)
     {
-      struct LabelPair pair = {res.label_name, program_size};
-      DARR_APP(&labels, struct LabelPair, pair);
+      op_t *op = ops + DARR_MEMBER(&emitter->relocations, size_t, j);
+      // Relative jumps are ints, anything else is a uint
+      if (data_type(op->operand) == DATA_INT)
+        op->operand = data_int(data_as_int(op->operand) + base);
+      else
+        op->operand = data_uint(data_as_uint(op->operand) + base);
     }
-    else if (res.type == PRES_IPTR)
+
+    for (size_t j = 0; j < emitter->fixups.used && perr == PERR_OK; ++j)
     {
-      // This means it wants the operand of res.immediate to be the
-      // next instruction pointer (as a uint)
-      u64 iptr         = program_size + 1;
-      data_type_t type = data_type(res.immediate.operand);
-      if (type == DATA_UINT)
-        iptr += data_as_uint(res.immediate.operand);
-      (results + i)->immediate.operand = data_uint(iptr);
-      ++program_size;
+      fixup_t fixup = DARR_MEMBER(&emitter->fixups, fixup_t, j);
+      word target   = 0;
+      if (htab_get(&labels, fixup.name, fixup.size, &target))
+        ops[fixup.address].operand = data_uint(target);
+      else
+      {
+        perr = PERR_UNKNOWN_LABEL;
+        if (error)
+          *error = (link_error_t){i, fixup.name, fixup.size};
+      }
     }
+    base += emitter->program.used;
+  }
+
+  htab_free(&labels);
+  if (perr != PERR_OK)
+  {
+    darr_free(program);
+    *program = (darr_t){0};
+  }
+  return perr;
+}
+
+bool emitter_assemble(emitter_t *emitter, buffer_t *buffer)
+{
+  stream_t stream = {0};
+  emitter_init(emitter);
+  if (tokenise_buffer(&stream, buffer) != LERR_OK)
+    return false;
+  // Labels defined elsewhere are left to emitter_link
+  bool ok = parse_emit(&stream, emitter) == PERR_OK;
+  emitter_resolve(emitter);
+  stream_free(&stream);
+  return ok;
+}
+
+void emitter_write_word(word w, FILE *fp)
+{
+  fwrite(&w, sizeof(w), 1, fp);
+}
+
+bool emitter_read_word(buffer_t *buffer, word *w)
+{
+  if (buffer_space_left(*buffer) < sizeof(*w))
+    return false;
+  memcpy(w, buffer->data + buffer->cur, sizeof(*w));
+  buffer->cur += sizeof(*w);
+  return true;
+}
+
+// A name of size bytes, pointing into the buffer
+bool emitter_read_name(buffer_t *buffer, word size, const char **name)
+{
+  if (size == 0 || size > buffer_space_left(*buffer))
+    return false;
+  *name = buffer->data + buffer->cur;
+  buffer->cur += size;
+  return true;
+}
+
+void emitter_write(emitter_t *emitter, FILE *fp)
+{
+  emitter_write_word(emitter->program.used, fp);
+  for (size_t i = 0; i < emitter->program.used; ++i)
+  {
+    op_t op     = DARR_MEMBER(&emitter->program, op_t, i);
+    byte opcode = op.opcode;
+    fwrite(&opcode, 1, 1, fp);
+    emitter_write_word((word)op.operand, fp);
   }
 
-  darr_init(output, program_size, sizeof(op_t));
-  // Fixup all label jumps
-  for (size_t i = 0; i < results_size; ++i)
+  emitter_write_word(emitter->relocations.used, fp);
+  fwrite(emitter->relocations.data, sizeof(size_t), emitter->relocations.used,
+         fp);
+
+  emitter_write_word(emitter->fixups.used, fp);
+  for (size_t i = 0; i < emitter->fixups.used; ++i)
   {
-    pres_t res = results[i];
-    if (res.type == PRES_LABEL)
+    fixup_t fixup = DARR_MEMBER(&emitter->fixups, fixup_t, i);
+    emitter_write_word(fixup.address, fp);
+    emitter_write_word(fixup.size, fp);
+    fwrite(fixup.name, 1, fixup.size, fp);
+  }
+
+  emitter_write_word(emitter->labels.used, fp);
+  for (size_t i = 0; i < emitter->labels.capacity; ++i)
+  {
+    htab_entry_t entry = emitter->labels.entries[i];
+    if (!entry.key)
       continue;
-    else if (res.type == PRES_IMMEDIATE || res.type == PRES_IPTR)
+    emitter_write_word(entry.value, fp);
+    emitter_write_word(entry.size, fp);
+    fwrite(entry.key, 1, entry.size, fp);
+  }
+}
+
+// Whether operand is a tagged word of a type opcode takes, as checked
+// by vm_read_program: data_type asserts on an untagged word
+bool emitter_read_operand(inst_t opcode, word operand)
+{
+  word tag = operand & MASK_NIL;
+  if (tag != TAG_INT && tag != TAG_UINT && tag != TAG_CHARACTER &&
+      tag != TAG_BOOLEAN && tag != TAG_FLOAT && tag != TAG_NIL)
+    return false;
+  data_type_t type = data_type((data_t *)operand);
+  switch (opcode)
+  {
+  case OP_NONE:
+  case OP_HALT:
+  case OP_PLUS:
+  case OP_MULT:
+  case OP_PRINT:
+  case OP_POP:
+    return operand == (word)data_nil();
+  case OP_PUSH:
+    return true;
+  case OP_DUP:
+    return type == DATA_UINT;
+  case OP_JUMP:
+    // Relative jumps are ints until emitter_link
+    return type == DATA_NIL || type == DATA_UINT || type == DATA_INT;
+  case NUMBER_OF_OPERATORS:
+  default:
+    return false;
+  }
+}
+
+bool emitter_read(emitter_t *emitter, buffer_t *buffer)
+{
+  emitter_init(emitter);
+  word count = 0;
+
+  // Each instruction is at least 9 bytes, which bounds count before
+  // it's trusted with an allocation
+  bool ok = emitter_read_word(buffer, &count) &&
+            count <= buffer_space_left(*buffer) / (1 + sizeof(word));
+  if (ok)
+    darr_ensure_capacity(&emitter->program, count);
+  for (word i = 0; ok && i < count; ++i)
+  {
+    byte opcode  = buffer_pop(buffer);
+    word operand = 0;
+    ok = emitter_read_word(buffer, &operand) &&
+         emitter_read_operand(opcode, operand);
+    DARR_MEMBER(&emitter->program, op_t, i) =
+        (op_t){.opcode = opcode, .operand = (data_t *)operand};
+    emitter->program.used += ok;
+  }
+  size_t size = emitter->program.used;
+
+  ok = ok && emitter_read_word(buffer, &count);
+  for (word i = 0; ok && i < count; ++i)
+  {
+    word address = 0;
+    ok           = emitter_read_word(buffer, &address) && address < size;
+    // emitter_link adds to the operand of a relocation, so it must hold
+    // an address
+    data_t *operand =
+        ok ? DARR_MEMBER(&emitter->program, op_t, address).operand : NULL;
+    ok = ok && (data_type(operand) == DATA_UINT ||
+                data_type(operand) == DATA_INT);
+    if (ok)
     {
-      DARR_APP(output, op_t, res.immediate);
+      DARR_APP(&emitter->relocations, size_t, address);
     }
-    else if (res.type == PRES_JUMP_LABEL)
-    {
-      op_t op  = {0};
-      size_t j = 0;
-      for (; j < labels.used; ++j)
-      {
-        struct LabelPair pair = ((struct LabelPair *)labels.data)[j];
-        if (complete_cmp_string(pair.name, res.label_name))
-        {
-          op = OP_CREATE_JMP(data_uint(pair.iptr));
-          break;
-        }
-      }
+  }
 
-      // If no corresponding label found
-      if (j == labels.used)
-      {
-        darr_free(output);
-        darr_free(&labels);
-        stream->cursor = res.stream_cursor;
-        return PERR_UNKNOWN_LABEL;
-      }
-      DARR_APP(output, op_t, op);
+  ok = ok && emitter_read_word(buffer, &count);
+  for (word i = 0; ok && i < count; ++i)
+  {
+    word address = 0, length = 0;
+    const char *name = NULL;
+    ok = emitter_read_word(buffer, &address) && address < size &&
+         DARR_MEMBER(&emitter->program, op_t, address).opcode == OP_JUMP &&
+         emitter_read_word(buffer, &length) &&
+         emitter_read_name(buffer, length, &name);
+    if (ok)
+    {
+      // Errors are reported against the source, not a serialised
+      // emitter, so there's no cursor
+      fixup_t fixup = {address, 0, arena_copy(&emitter->names, name, length),
+                       length};
+      DARR_APP(&emitter->fixups, fixup_t, fixup);
     }
   }
 
-  darr_free(&labels);
+  ok = ok && emitter_read_word(buffer, &count);
+  for (word i = 0; ok && i < count; ++i)
+  {
+    word address = 0, length = 0;
+    const char *name = NULL;
+    ok = emitter_read_word(buffer, &address) && address <= size &&
+         emitter_read_word(buffer, &length) &&
+         emitter_read_name(buffer, length, &name) &&
+         htab_insert(&emitter->labels, name, length, address);
+  }
 
-  return PERR_OK;
+  if (!ok)
+    emitter_free(emitter);
+  return ok;
 }
 
-perr_t parse_stream(stream_t *stream, op_t **instructions,
-                    u64 *instructions_parsed)
+perr_t parse_emit(stream_t *stream, emitter_t *emitter)
 {
-  if (stream->cursor >= stream->size)
-    return PERR_EOF;
-
-  darr_t presults = {0};
-  darr_init(&presults, DARR_INITAL_SIZE, sizeof(pres_t));
-
   stream_seek_next(stream);
-  while (stream->cursor < stream->size && stream_peek(stream).type != TOKEN_EOF)
+  while (!stream_at_end(stream) && stream_peek(stream).type != TOKEN_EOF)
   {
     pres_t pres = {0};
     perr_t perr = parse_line(stream, &pres);
-
+    if (perr == PERR_OK)
+      perr = emitter_emit(emitter, stream, pres);
     if (perr != PERR_OK)
-    {
-      darr_free(&presults);
       return perr;
-    }
-
-    DARR_APP(&presults, pres_t, pres);
     // Bring us to the next token
     stream_seek_next(stream);
   }
+  return PERR_OK;
+}
 
-  darr_t processed = {0};
-  perr_t process_error =
-      process_presults(presults.data, presults.used, stream, &processed);
-
-  darr_free(&presults);
+perr_t parse_stream(stream_t *stream, op_t **instructions,
+                    u64 *instructions_parsed)
+{
+  if (stream_at_end(stream))
+    return PERR_EOF;
 
-  if (process_error != PERR_OK)
-    return process_error;
+  emitter_t emitter = {0};
+  emitter_init(&emitter);
+  perr_t perr = parse_emit(stream, &emitter);
+  if (perr == PERR_OK)
+    perr = emitter_finish(&emitter, stream);
+  if (perr != PERR_OK)
+  {
+    emitter_free(&emitter);
+    return perr;
+  }
 
-  *instructions        = processed.data;
-  *instructions_parsed = processed.used;
+  *instructions        = emitter.program.data;
+  *instructions_parsed = emitter.program.used;
+  // The program now belongs to the caller
+  emitter.program = (darr_t){0};
+  emitter_free(&emitter);
   return PERR_OK;
 }
 
@@ -569,6 +788,8 @@ const char *perr_as_cstr(perr_t err)
     return "PERR_ILLEGAL_INST_ADDRESS";
   case PERR_EOF:
     return "PERR_EOF";
+  case PERR_DUPLICATE_LABEL:
+    return "PERR_DUPLICATE_LABEL";
   case NUMBER_OF_PERRORS:
     // This really shouldn't happen
   default:
@@ -579,12 +800,20 @@ const char *perr_as_cstr(perr_t err)
 char *perr_generate(perr_t err, stream_t *stream)
 {
   const char *err_cstr = perr_as_cstr(err);
-  token_t token        = stream_peek(stream);
-  int char_num_size    = snprintf(NULL, 0, "%s:%zu:%zu: %s", stream->name,
-                                  token.line, token.column, err_cstr);
-  char *message        = calloc(char_num_size + 1, sizeof(*message));
-  sprintf(message, "%s:%zu:%zu: %s", stream->name, token.line, token.column,
-          err_cstr);
+  size_t line = 0, column = 0;
+  // A streaming lexer may have dropped the token already
+  if (!stream_position(stream, stream->cursor, &line, &column))
+  {
+    int char_num_size = snprintf(NULL, 0, "%s: %s", stream->name, err_cstr);
+    char *message = calloc(char_num_size + 1, sizeof(*message));
+    sprintf(message, "%s: %s", stream->name, err_cstr);
+    message[char_num_size] = '\0';
+    return message;
+  }
+  int char_num_size =
+      snprintf(NULL, 0, "%s:%zu:%zu: %s", stream->name, line, column, err_cstr);
+  char *message = calloc(char_num_size + 1, sizeof(*message));
+  sprintf(message, "%s:%zu:%zu: %s", stream->name, line, column, err_cstr);
   message[char_num_size] = '\0';
   return message;
 }
@@ -35,6 +35,9 @@ typedef enum
   PERR_ILLEGAL_INST_ADDRESS,
   PERR_EOF,
 
+  // After the rest so their exit codes (255 - perr) stay the same
+  PERR_DUPLICATE_LABEL,
+
   NUMBER_OF_PERRORS,
 } perr_t;
 
@@ -57,7 +60,12 @@ typedef struct
   union
   {
     op_t immediate;
-    char *label_name;
+    // From stream_intern, so it outlives a streaming lexer's window
+    struct
+    {
+      const char *name;
+      size_t size;
+    } label;
     data_t *operand;
   };
 } pres_t;
@@ -76,8 +84,106 @@ perr_t parse_dup(stream_t *, pres_t *);
 perr_t parse_label(stream_t *, pres_t *);
 perr_t parse_jmp(stream_t *, pres_t *);
 
+/* Mnemonics are found with a perfect hash of their size and first two
+ * characters (the second is 0 for single characters), so a symbol is
+ * looked up in one probe then compared exactly.  Every mnemonic is one
+ * entry of PARSER_MNEMONICS in parser.c: a new one which collides is a
+ * warning there (-Woverride-init), solved by changing the multipliers
+ * or adding slots. */
+#define PARSER_MNEMONIC_SLOTS 16
+#define PARSER_MNEMONIC_HASH(SIZE, FIRST, SECOND)               \
+  (((byte)(FIRST) * 2 + (byte)(SECOND) * 5 + (size_t)(SIZE)) & \
+   (PARSER_MNEMONIC_SLOTS - 1))
+
+typedef struct
+{
+  const char *name;
+  size_t size;
+  // Mnemonics with an operand leave the result to their parser,
+  // anything else is an immediate of opcode
+  inst_t opcode;
+  perr_t (*parse)(stream_t *, pres_t *);
+} mnemonic_t;
+
+// The mnemonic a symbol token is exactly, or NULL
+const mnemonic_t *parser_mnemonic(stream_t *, token_t);
+
 perr_t parse_line(stream_t *, pres_t *);
-perr_t process_presults(pres_t *, size_t, stream_t *, darr_t *);
+
+/* Single pass emitter: every parse result is written straight into
+ * the program as it is parsed.  A jump to a label defined later gets a
+ * placeholder operand and a fixup, which are patched once the whole
+ * source has been seen; every other operand (relative jumps, `push *N`
+ * and jumps to labels already defined) is known when it is emitted.
+ *
+ * Addresses an emitter computes are relative to its first instruction,
+ * and every operand holding one is recorded as a relocation, so the
+ * programs of several emitters (i.e. pieces of one source) can be
+ * linked together by emitter_link. */
+typedef struct
+{
+  size_t address, stream_cursor;
+  // From stream_intern, see pres_t
+  const char *name;
+  size_t size;
+} fixup_t;
+
+typedef struct
+{
+  darr_t program;     // op_t
+  darr_t fixups;      // fixup_t
+  darr_t relocations; // size_t, addresses of relative operands
+  htab_t labels;      // name -> address
+  // Names of fixups read by emitter_read
+  arena_t names;
+} emitter_t;
+
+/* Revision of what the parser and emitter make of a source: bump it
+ * whenever any source assembles to different bytecode or relocations,
+ * so emitters saved by an older assembler (see cache.h) are thrown
+ * away rather than reused. */
+#define PARSER_REVISION 1
+
+void emitter_init(emitter_t *);
+void emitter_free(emitter_t *);
+perr_t emitter_emit(emitter_t *, stream_t *, pres_t);
+// Patch every fixup whose label is now defined, returning the number
+// left (jumps to labels outside this emitter)
+size_t emitter_resolve(emitter_t *);
+// Patch every fixup, failing on the first label that was never defined
+perr_t emitter_finish(emitter_t *, stream_t *);
+/* Concatenate the programs of a sequence of resolved emitters into
+ * program, relocating their addresses and resolving fixups between
+ * them.  Errors have no position as there is no one stream they could
+ * refer to, but if error isn't NULL it is set to the emitter and label
+ * at fault. */
+typedef struct
+{
+  size_t emitter;
+  const char *name;
+  size_t size;
+} link_error_t;
+
+perr_t emitter_link(emitter_t *, size_t, darr_t *program, link_error_t *);
+
+// Assemble a buffer, which may be a view into a larger source, into an
+// emitter ready to be linked.  Returns false on any error, leaving it
+// for an assembly of the whole source to report.  Label names in the
+// emitter point into the buffer.
+bool emitter_assemble(emitter_t *, buffer_t *);
+
+/* Serialisation of a resolved emitter: its program, relocations,
+ * fixups and labels, in native byte order.  emitter_read reads one
+ * from the buffer's cursor, initialising the emitter, and returns
+ * false (freeing it) on a truncated or malformed input. */
+void emitter_write(emitter_t *, FILE *);
+bool emitter_read(emitter_t *, buffer_t *);
+// A word in native byte order from the buffer's cursor
+bool emitter_read_word(buffer_t *, word *);
+
+// Parse every line left in the stream into the emitter, leaving its
+// fixups to the caller
+perr_t parse_emit(stream_t *, emitter_t *);
 perr_t parse_stream(stream_t *, op_t **, u64 *);
 
 #endif
@@ -0,0 +1,351 @@
+/* pipeline.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Pipelined assembly over lock-free rings
+ */
+
+// For sched_yield
+#define _DEFAULT_SOURCE
+
+#include "./pipeline.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+void ring_init(ring_t *ring, size_t slot_size, size_t capacity)
+{
+  ring->slots     = calloc(capacity, slot_size);
+  ring->slot_size = slot_size;
+  ring->capacity  = capacity;
+  ring->full_ns   = 0;
+  ring->empty_ns  = 0;
+  atomic_init(&ring->closed, false);
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+}
+
+void ring_free(ring_t *ring)
+{
+  free(ring->slots);
+  ring->slots = NULL;
+}
+
+void *ring_reserve(ring_t *ring)
+{
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  u64 started = 0;
+  while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) ==
+             ring->capacity &&
+         !atomic_load_explicit(&ring->closed, memory_order_relaxed))
+  {
+    if (!started)
+      started = time_now_ns();
+    sched_yield();
+  }
+  if (started)
+    ring->full_ns += time_now_ns() - started;
+  if (atomic_load_explicit(&ring->closed, memory_order_relaxed))
+    return NULL;
+  return ring->slots + (head & (ring->capacity - 1)) * ring->slot_size;
+}
+
+void ring_publish(ring_t *ring)
+{
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void *ring_peek(ring_t *ring)
+{
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  u64 started = 0;
+  while (atomic_load_explicit(&ring->head, memory_order_acquire) == tail)
+  {
+    if (!started)
+      started = time_now_ns();
+    sched_yield();
+  }
+  if (started)
+    ring->empty_ns += time_now_ns() - started;
+  return ring->slots + (tail & (ring->capacity - 1)) * ring->slot_size;
+}
+
+void ring_release(ring_t *ring)
+{
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+void ring_close(ring_t *ring)
+{
+  atomic_store_explicit(&ring->closed, true, memory_order_relaxed);
+}
+
+const char *pipeline_stage_as_cstr(pipeline_stage_t stage)
+{
+  switch (stage)
+  {
+  case PIPELINE_LEXER:
+    return "lexer";
+  case PIPELINE_PARSER:
+    return "parser";
+  case PIPELINE_EMITTER:
+    return "emitter";
+  case NUMBER_OF_PIPELINE_STAGES:
+  default:
+    return "";
+  }
+}
+
+// Every stage ends its output with a batch marked last, unless the
+// next stage closed it
+typedef struct
+{
+  size_t used;
+  // Where the lexer stopped, for errors
+  size_t cur;
+  lerr_t lerr;
+  bool last;
+  token_t tokens[PIPELINE_BATCH];
+} token_batch_t;
+
+typedef struct
+{
+  size_t used;
+  perr_t perr;
+  bool last;
+  pres_t results[PIPELINE_BATCH];
+} pres_batch_t;
+
+typedef struct
+{
+  buffer_t *buffer;
+  stream_t *stream;
+  ring_t tokens, results;
+  u64 wall_ns[NUMBER_OF_PIPELINE_STAGES];
+} pipeline_t;
+
+void *pipeline_lexer(void *arg)
+{
+  pipeline_t *pipeline = arg;
+  buffer_t *buffer     = pipeline->buffer;
+  u64 started          = time_now_ns();
+  for (bool last = false; !last;)
+  {
+    token_batch_t *batch = ring_reserve(&pipeline->tokens);
+    if (!batch)
+      break;
+    batch->used = 0;
+    batch->lerr = LERR_OK;
+    while (batch->used < PIPELINE_BATCH &&
+           buffer_at_end(*buffer) != BUFFER_PAST_END &&
+           batch->lerr == LERR_OK)
+    {
+      batch->lerr = lexer_next(buffer, batch->tokens + batch->used);
+      if (batch->lerr == LERR_OK)
+        ++batch->used;
+    }
+    batch->cur  = buffer->cur;
+    batch->last = batch->lerr != LERR_OK ||
+                  buffer_at_end(*buffer) == BUFFER_PAST_END;
+    last = batch->last;
+    ring_publish(&pipeline->tokens);
+  }
+  pipeline->wall_ns[PIPELINE_LEXER] = time_now_ns() - started;
+  return NULL;
+}
+
+bool pipeline_feed(stream_t *stream)
+{
+  pipeline_t *pipeline = stream->feed_context;
+  token_batch_t *batch = ring_peek(&pipeline->tokens);
+  for (size_t i = 0; i < batch->used; ++i)
+    stream_append(stream, batch->tokens[i]);
+  if (batch->lerr != LERR_OK)
+  {
+    stream->lerr       = batch->lerr;
+    stream->window_cur = batch->cur;
+  }
+  bool last = batch->last;
+  ring_release(&pipeline->tokens);
+  return !last;
+}
+
+pres_batch_t *pipeline_results_batch(pipeline_t *pipeline)
+{
+  pres_batch_t *batch = ring_reserve(&pipeline->results);
+  if (batch)
+  {
+    batch->used = 0;
+    batch->perr = PERR_OK;
+    batch->last = false;
+  }
+  return batch;
+}
+
+void *pipeline_parser(void *arg)
+{
+  pipeline_t *pipeline = arg;
+  stream_t *stream     = pipeline->stream;
+  u64 started          = time_now_ns();
+  pres_batch_t *batch  = pipeline_results_batch(pipeline);
+
+  // Same as parse_stream, handing results to the emitter
+  if (batch && stream_at_end(stream))
+    batch->perr = PERR_EOF;
+  stream_seek_next(stream);
+  while (batch && !stream_at_end(stream) &&
+         stream_peek(stream).type != TOKEN_EOF)
+  {
+    pres_t *pres = batch->results + batch->used;
+    *pres        = (pres_t){0};
+    batch->perr  = parse_line(stream, pres);
+    if (batch->perr != PERR_OK)
+      break;
+    else if (++batch->used == PIPELINE_BATCH)
+    {
+      ring_publish(&pipeline->results);
+      batch = pipeline_results_batch(pipeline);
+    }
+    stream_seek_next(stream);
+  }
+  if (batch)
+  {
+    batch->last = true;
+    ring_publish(&pipeline->results);
+  }
+  // Nothing more will be read from the lexer, if it's still going
+  ring_close(&pipeline->tokens);
+  pipeline->wall_ns[PIPELINE_PARSER] = time_now_ns() - started;
+  return NULL;
+}
+
+// For when the threads can't be started
+perr_t pipeline_sequential(buffer_t *buffer, stream_t *stream,
+                           op_t **instructions, u64 *instructions_size)
+{
+  lerr_t lerr = tokenise_buffer(stream, buffer);
+  if (lerr == LERR_OK)
+    return parse_stream(stream, instructions, instructions_size);
+  stream_init_feed(stream, buffer->name, buffer->data, buffer->available,
+                   NULL, NULL);
+  stream->lerr       = lerr;
+  stream->window_cur = buffer->cur;
+  return PERR_OK;
+}
+
+perr_t pipeline_assemble(buffer_t *buffer, stream_t *stream,
+                         op_t **instructions, u64 *instructions_size,
+                         pipeline_stats_t stats[NUMBER_OF_PIPELINE_STAGES])
+{
+  if (buffer->available > UINT32_MAX)
+  {
+    stream_init_feed(stream, buffer->name, buffer->data, buffer->available,
+                     NULL, NULL);
+    stream->lerr = LERR_SOURCE_TOO_LARGE;
+    return PERR_OK;
+  }
+  pipeline_t pipeline = {.buffer = buffer, .stream = stream};
+  stream_init_feed(stream, buffer->name, buffer->data, buffer->available,
+                   pipeline_feed, &pipeline);
+  ring_init(&pipeline.tokens, sizeof(token_batch_t), PIPELINE_SLOTS);
+  ring_init(&pipeline.results, sizeof(pres_batch_t), PIPELINE_SLOTS);
+
+  pthread_t parser, lexer;
+  bool parsing =
+      pthread_create(&parser, NULL, pipeline_parser, &pipeline) == 0;
+  bool lexing =
+      parsing && pthread_create(&lexer, NULL, pipeline_lexer, &pipeline) == 0;
+  if (!lexing)
+  {
+    if (parsing)
+    {
+      // Stand in for the lexer, with no tokens
+      token_batch_t *batch = ring_reserve(&pipeline.tokens);
+      *batch = (token_batch_t){.lerr = LERR_OK, .last = true};
+      ring_publish(&pipeline.tokens);
+      pthread_join(parser, NULL);
+    }
+    ring_free(&pipeline.tokens);
+    ring_free(&pipeline.results);
+    stream_free(stream);
+    return pipeline_sequential(buffer, stream, instructions,
+                               instructions_size);
+  }
+
+  // The emitter is this thread.  The parser is still using stream, so
+  // errors from emitting record their cursor elsewhere until it's done.
+  u64 started       = time_now_ns();
+  emitter_t emitter = {0};
+  stream_t errors   = {0};
+  perr_t perr       = PERR_OK;
+  bool emitted      = true, last = false;
+  emitter_init(&emitter);
+  while (!last && perr == PERR_OK)
+  {
+    pres_batch_t *batch = ring_peek(&pipeline.results);
+    for (size_t i = 0; i < batch->used && perr == PERR_OK; ++i)
+      perr = emitter_emit(&emitter, &errors, batch->results[i]);
+    if (perr == PERR_OK && batch->perr != PERR_OK)
+    {
+      perr    = batch->perr;
+      emitted = false;
+    }
+    last = batch->last;
+    ring_release(&pipeline.results);
+  }
+  if (!last)
+    ring_close(&pipeline.results);
+
+  pthread_join(parser, NULL);
+  pthread_join(lexer, NULL);
+  if (perr == PERR_OK)
+    perr = emitter_finish(&emitter, stream);
+  else if (emitted)
+    stream->cursor = errors.cursor;
+  pipeline.wall_ns[PIPELINE_EMITTER] = time_now_ns() - started;
+
+  stats[PIPELINE_LEXER] = (pipeline_stats_t){
+      .wall_ns    = pipeline.wall_ns[PIPELINE_LEXER],
+      .blocked_ns = pipeline.tokens.full_ns,
+  };
+  stats[PIPELINE_PARSER] = (pipeline_stats_t){
+      .wall_ns    = pipeline.wall_ns[PIPELINE_PARSER],
+      .starved_ns = pipeline.tokens.empty_ns,
+      .blocked_ns = pipeline.results.full_ns,
+  };
+  stats[PIPELINE_EMITTER] = (pipeline_stats_t){
+      .wall_ns    = pipeline.wall_ns[PIPELINE_EMITTER],
+      .starved_ns = pipeline.results.empty_ns,
+  };
+  ring_free(&pipeline.tokens);
+  ring_free(&pipeline.results);
+
+  if (perr != PERR_OK)
+  {
+    emitter_free(&emitter);
+    return perr;
+  }
+  *instructions      = emitter.program.data;
+  *instructions_size = emitter.program.used;
+  // The program now belongs to the caller
+  emitter.program = (darr_t){0};
+  emitter_free(&emitter);
+  return PERR_OK;
+}
+
+void pipeline_print_stats(pipeline_stats_t stats[NUMBER_OF_PIPELINE_STAGES],
+                          FILE *fp)
+{
+  fprintf(fp, "%-10s %12s %12s %12s %12s\n", "STAGE", "WALL-MS", "BUSY-MS",
+          "STARVED-MS", "BLOCKED-MS");
+  for (size_t i = 0; i < NUMBER_OF_PIPELINE_STAGES; ++i)
+  {
+    pipeline_stats_t stage = stats[i];
+    u64 stalled            = stage.starved_ns + stage.blocked_ns;
+    u64 busy = stage.wall_ns > stalled ? stage.wall_ns - stalled : 0;
+    fprintf(fp, "%-10s %12.3f %12.3f %12.3f %12.3f\n",
+            pipeline_stage_as_cstr(i), stage.wall_ns / 1e6, busy / 1e6,
+            stage.starved_ns / 1e6, stage.blocked_ns / 1e6);
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "./lexer.h"
+#include "./lib.h"
+#include "./op.h"
+#include "./parser.h"
+
+#include <stdatomic.h>
+
+/* Single producer, single consumer lock-free ring of fixed size slots.
+ * Slots are filled and read in place: the producer fills the slot from
+ * ring_reserve then publishes it, the consumer reads the slot from
+ * ring_peek then releases it.  Both block (yielding) while the ring is
+ * full or empty, adding the time to full_ns or empty_ns.  A consumer
+ * which stops early closes the ring so its producer doesn't block
+ * forever: ring_reserve then returns NULL. */
+#define RING_CACHE_LINE 64
+typedef struct
+{
+  byte *slots;
+  size_t slot_size, capacity;
+  atomic_bool closed;
+  // Only written by the producer
+  _Alignas(RING_CACHE_LINE) atomic_size_t head;
+  u64 full_ns;
+  // Only written by the consumer
+  _Alignas(RING_CACHE_LINE) atomic_size_t tail;
+  u64 empty_ns;
+} ring_t;
+
+// capacity must be a power of 2
+void ring_init(ring_t *, size_t slot_size, size_t capacity);
+void ring_free(ring_t *);
+void *ring_reserve(ring_t *);
+void ring_publish(ring_t *);
+void *ring_peek(ring_t *);
+void ring_release(ring_t *);
+void ring_close(ring_t *);
+
+/* Pipelined assembly of a source in memory: the lexer, the parser and
+ * the emitter each run on their own thread, passing batches of tokens
+ * then parse results to the next stage through rings.  The parser reads
+ * its tokens through a fed stream, so the result is the same as
+ * tokenise_buffer then parse_stream, with errors reported the same way:
+ * lexer errors in stream->lerr (see stream_lerr_generate), parse errors
+ * as the return value at stream->cursor. */
+#define PIPELINE_BATCH 256
+#define PIPELINE_SLOTS 64
+
+typedef enum
+{
+  PIPELINE_LEXER = 0,
+  PIPELINE_PARSER,
+  PIPELINE_EMITTER,
+
+  NUMBER_OF_PIPELINE_STAGES,
+} pipeline_stage_t;
+
+// Starved: waiting on the previous stage, blocked: waiting on the next
+typedef struct
+{
+  u64 wall_ns, starved_ns, blocked_ns;
+} pipeline_stats_t;
+
+const char *pipeline_stage_as_cstr(pipeline_stage_t);
+
+// stream must be freed by the caller, even on error
+perr_t pipeline_assemble(buffer_t *, stream_t *stream, op_t **instructions,
+                         u64 *instructions_size,
+                         pipeline_stats_t stats[NUMBER_OF_PIPELINE_STAGES]);
+void pipeline_print_stats(pipeline_stats_t stats[NUMBER_OF_PIPELINE_STAGES],
+                          FILE *);
+
+#endif
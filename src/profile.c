@@ -0,0 +1,197 @@
+/* profile.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Basic block and jump edge profiling of a loaded program
+ */
+
+#include "./profile.h"
+
+#include <string.h>
+
+void profile_init(profile_t *prof, vm_t *vm)
+{
+  size_t size = vm->size_program;
+
+  // Mark leaders: the entry point, the targets of static jumps, the
+  // instruction after every jump and every address pushed as a uint
+  // (as `push *N` return addresses are the targets of `jmp *`).
+  bool *is_leader = calloc(size + 1, sizeof(*is_leader));
+  is_leader[0]    = true;
+  for (size_t i = 0; i < size; ++i)
+  {
+    op_t op = vm->program[i];
+    if (op.opcode == OP_JUMP)
+    {
+      is_leader[i + 1] = true;
+      if (data_type(op.operand) == DATA_UINT &&
+          data_as_uint(op.operand) <= size)
+        is_leader[data_as_uint(op.operand)] = true;
+    }
+    else if (op.opcode == OP_PUSH && data_type(op.operand) == DATA_UINT &&
+             data_as_uint(op.operand) <= size)
+      is_leader[data_as_uint(op.operand)] = true;
+  }
+
+  prof->size_program = size;
+  prof->blocks       = 0;
+  for (size_t i = 0; i < size; ++i)
+    if (is_leader[i])
+      ++prof->blocks;
+
+  prof->block_of     = calloc(size + 1, sizeof(*prof->block_of));
+  prof->leaders      = calloc(prof->blocks + 1, sizeof(*prof->leaders));
+  prof->block_counts = calloc(prof->blocks + 1, sizeof(*prof->block_counts));
+  prof->edge_of      = calloc(size + 1, sizeof(*prof->edge_of));
+
+  for (size_t i = 0, block = 0; i < size; ++i)
+  {
+    if (is_leader[i])
+      prof->leaders[block++] = i;
+    prof->block_of[i] = block - 1;
+    prof->edge_of[i]  = PROFILE_NO_EDGE;
+  }
+  // Jumping to the end of a program is legal, so give it a block
+  prof->block_of[size]        = prof->blocks;
+  prof->leaders[prof->blocks] = size;
+  prof->edge_of[size]         = PROFILE_NO_EDGE;
+
+  darr_init(&prof->edges, DARR_INITAL_SIZE, sizeof(profile_edge_t));
+  htab_init(&prof->edge_index, HTAB_INITIAL_SIZE);
+  free(is_leader);
+}
+
+void profile_free(profile_t *prof)
+{
+  free(prof->block_of);
+  free(prof->leaders);
+  free(prof->block_counts);
+  free(prof->edge_of);
+  darr_free(&prof->edges);
+  htab_free(&prof->edge_index);
+  *prof = (profile_t){0};
+}
+
+void profile_record_edge(profile_t *prof, word from, word to)
+{
+  profile_edge_t *edges = prof->edges.data;
+  size_t cached         = prof->edge_of[from];
+
+  // Static jumps always hit their cached edge; `jmp *` falls back to
+  // looking up the (from, to) pair.
+  if (cached == PROFILE_NO_EDGE || edges[cached].to != to)
+  {
+    word key[2] = {from, to}, index = 0;
+    if (!htab_get(&prof->edge_index, (const char *)key, sizeof(key), &index))
+    {
+      index               = prof->edges.used;
+      profile_edge_t edge = {from, to, 0};
+      DARR_APP(&prof->edges, profile_edge_t, edge);
+      htab_insert(&prof->edge_index, (const char *)key, sizeof(key), index);
+      edges = prof->edges.data;
+    }
+    cached              = index;
+    prof->edge_of[from] = cached;
+  }
+  ++edges[cached].count;
+}
+
+err_t profile_execute_all(profile_t *prof, vm_t *vm)
+{
+  err_t err   = ERR_OK;
+  bool jumped = true;
+  u64 started = time_now_ns();
+  while (vm->iptr < vm->size_program && vm->program[vm->iptr].opcode != OP_HALT)
+  {
+    word iptr    = vm->iptr;
+    size_t block = prof->block_of[iptr];
+    // A dynamic jump may land in the middle of a block, so count any
+    // landing site as an entry into its block
+    if (jumped || prof->leaders[block] == iptr)
+      ++prof->block_counts[block];
+
+    err = vm_execute(vm);
+    if (err != ERR_OK)
+      break;
+
+    jumped = vm->program[iptr].opcode == OP_JUMP;
+    if (jumped)
+      profile_record_edge(prof, iptr, vm->iptr);
+  }
+  vm->stats.wall_ns += time_now_ns() - started;
+  vm->stats.error = err;
+  return err;
+}
+
+int profile_edge_cmp(const void *a, const void *b)
+{
+  const profile_edge_t *x = a, *y = b;
+  if (x->from != y->from)
+    return x->from < y->from ? -1 : 1;
+  else if (x->to != y->to)
+    return x->to < y->to ? -1 : 1;
+  return 0;
+}
+
+void profile_write(profile_t *prof, FILE *fp)
+{
+  qsort(prof->edges.data, prof->edges.used, sizeof(profile_edge_t),
+        profile_edge_cmp);
+  // The cached indices are now stale
+  for (size_t i = 0; i <= prof->size_program; ++i)
+    prof->edge_of[i] = PROFILE_NO_EDGE;
+  htab_free(&prof->edge_index);
+  htab_init(&prof->edge_index, prof->edges.used * 2);
+  for (size_t i = 0; i < prof->edges.used; ++i)
+  {
+    profile_edge_t edge = DARR_MEMBER(&prof->edges, profile_edge_t, i);
+    word key[2]         = {edge.from, edge.to};
+    htab_insert(&prof->edge_index, (const char *)key, sizeof(key), i);
+  }
+
+  fprintf(fp, ";; profile: %lu instructions, %lu blocks, %lu edges\n",
+          prof->size_program, prof->blocks, prof->edges.used);
+  // block FIRST LAST COUNT, where LAST is inclusive
+  for (size_t i = 0; i < prof->blocks; ++i)
+    fprintf(fp, "block %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+            prof->leaders[i], prof->leaders[i + 1] - 1, prof->block_counts[i]);
+  // edge FROM TO COUNT
+  for (size_t i = 0; i < prof->edges.used; ++i)
+  {
+    profile_edge_t edge = DARR_MEMBER(&prof->edges, profile_edge_t, i);
+    fprintf(fp, "edge %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", edge.from,
+            edge.to, edge.count);
+  }
+}
+
+bool profile_read(FILE *fp, size_t size_program, u64 *block_counts,
+                  u64 *jump_counts)
+{
+  // Every line profile_write produces fits easily
+  char line[256];
+  u64 size = 0, first = 0, last = 0, count = 0;
+  if (!fgets(line, sizeof(line), fp) ||
+      sscanf(line, ";; profile: %" SCNu64 " instructions", &size) != 1 ||
+      size != size_program)
+    return false;
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    if (sscanf(line, "block %" SCNu64 " %" SCNu64 " %" SCNu64, &first, &last,
+               &count) == 3)
+    {
+      if (first > last || last >= size)
+        return false;
+      block_counts[first] += count;
+    }
+    else if (sscanf(line, "edge %" SCNu64 " %" SCNu64 " %" SCNu64, &first,
+                    &last, &count) == 3)
+    {
+      if (first >= size || last > size)
+        return false;
+      jump_counts[first] += count;
+    }
+    else if (line[0] != ';' && line[0] != '\n')
+      return false;
+  }
+  return !ferror(fp);
+}
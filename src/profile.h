@@ -0,0 +1,57 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "./err.h"
+#include "./lib.h"
+#include "./vm.h"
+
+/* Basic block execution and jump edge profiling.  Counters are kept
+ * in arrays owned by the profile, indexed by block number, so the
+ * program being profiled is never modified. */
+
+typedef struct
+{
+  word from, to;
+  u64 count;
+} profile_edge_t;
+
+typedef struct
+{
+  size_t size_program, blocks;
+
+  // Block number of each instruction (size_program + 1 members, the
+  // last being a sentinel for "jumped to the end of the program")
+  size_t *block_of;
+  // Address of the leader of each block
+  word *leaders;
+  // Number of times each block was entered
+  u64 *block_counts;
+
+  // Taken OP_JUMP edges (profile_edge_t)
+  darr_t edges;
+  // For each OP_JUMP, the index into edges it last recorded into
+  size_t *edge_of;
+  // (from, to) -> index into edges, for `jmp *` which changes target
+  htab_t edge_index;
+} profile_t;
+
+#define PROFILE_NO_EDGE ((size_t)-1)
+
+void profile_init(profile_t *, vm_t *);
+void profile_free(profile_t *);
+
+void profile_record_edge(profile_t *, word from, word to);
+err_t profile_execute_all(profile_t *, vm_t *);
+
+void profile_write(profile_t *, FILE *);
+
+/* Read back a profile written by profile_write, which must be of a
+ * program of size_program instructions.  The first instruction of each
+ * block gets the number of times the block was entered (block_counts)
+ * and each jump the number of times it was taken (jump_counts), both
+ * arrays of size_program members which are added to.  Returns false if
+ * the file isn't such a profile. */
+bool profile_read(FILE *, size_t size_program, u64 *block_counts,
+                  u64 *jump_counts);
+
+#endif
@@ -6,7 +6,7 @@
 
 #include "./vm.h"
 
-#include <assert.h>
+#include <malloc.h>
 #include <string.h>
 
 void vm_print_all(vm_t *vm, FILE *fp)
@@ -39,213 +39,387 @@ void vm_print_all(vm_t *vm, FILE *fp)
   }
 }
 
-err_t vm_execute(vm_t *vm)
+err_t vm_exec_none(vm_t *vm, op_t op)
 {
-#if DEBUG
-  vm_print_all(vm, stderr);
-  fputs("\n", stderr);
-#endif
-  op_t op = (vm->program[vm->iptr]);
-  switch (op.opcode)
-  {
-  case OP_NONE:
-    vm->iptr++;
-    break;
-  case OP_HALT:
-    vm->iptr++;
-    break;
-  case OP_POP:
-    if (vm->sptr == 0)
-      return ERR_STACK_UNDERFLOW;
-    vm->sptr--;
-    vm->iptr++;
-    break;
-  case OP_PUSH:
-    if (vm->sptr >= VM_STACK_MAX)
-      return ERR_STACK_OVERFLOW;
-    vm->stack[vm->sptr] = op.operand;
-    vm->sptr++;
-    vm->iptr++;
-    break;
-  case OP_PLUS: {
-    if (vm->sptr < 2)
-      return ERR_STACK_UNDERFLOW;
-    data_t *a = vm->stack[vm->sptr - 2];
-    data_t *b = vm->stack[vm->sptr - 1];
+  (void)op;
+  vm->iptr++;
+  return ERR_OK;
+}
 
-    data_type_t a_ = data_type(a);
-    data_type_t b_ = data_type(b);
+err_t vm_exec_halt(vm_t *vm, op_t op)
+{
+  (void)op;
+  vm->iptr++;
+  return ERR_OK;
+}
 
-    if (!(data_type_is_numeric(a_) && data_type_is_numeric(b_)))
-      return ERR_ILLEGAL_TYPE;
+err_t vm_exec_pop(vm_t *vm, op_t op)
+{
+  (void)op;
+  if (vm->sptr == 0)
+    return ERR_STACK_UNDERFLOW;
+  vm->sptr--;
+  vm->iptr++;
+  return ERR_OK;
+}
 
-    data_numerics_promote_on_float(&a, &a_, &b, &b_);
+err_t vm_exec_push(vm_t *vm, op_t op)
+{
+  if (vm->sptr >= VM_STACK_MAX)
+    return ERR_STACK_OVERFLOW;
+  vm->stack[vm->sptr] = op.operand;
+  vm->sptr++;
+  vm->iptr++;
+  vm->stats.max_sptr = MAX(vm->stats.max_sptr, vm->sptr);
+  return ERR_OK;
+}
 
-    // Check if float (if so, just add now)
-    if (a_ == DATA_FLOAT)
-    {
-      vm->stack[vm->sptr - 2] = data_float(data_as_float(a) + data_as_float(b));
-    }
-    else if ((a_ == DATA_INT && b_ == DATA_UINT) ||
-             (a_ == DATA_UINT && b_ == DATA_INT))
-    {
-      u64 c = data_as_uint(a_ == DATA_INT ? b : a);
-      i64 d = data_as_int(a_ == DATA_INT ? a : b);
-      if (d > 0 && (c > (UINT60_MAX - d)))
-        // Integer overflow
-        return ERR_INTEGER_OVERFLOW;
-      // Cast to integer
-      else if (d < 0)
-        vm->stack[vm->sptr - 2] = data_int(c + d);
-      else
-        // Cast to unsigned
-        vm->stack[vm->sptr - 2] = data_uint(c + d);
-    }
-    else if (a_ == DATA_INT)
-    {
-      i64 c = data_as_int(a);
-      i64 d = data_as_int(b);
-
-      if (c > 0 && (d > (INT60_MAX - c)))
-        return ERR_INTEGER_OVERFLOW;
-      else if (c < 0 && d < (INT60_MIN - c))
-        return ERR_INTEGER_UNDERFLOW;
-      vm->stack[vm->sptr - 2] = data_int(c + d);
-    }
-    else
-    {
-      u64 c = data_as_uint(a);
-      u64 d = data_as_uint(b);
+err_t vm_plus(data_t *a, data_t *b, data_t **result)
+{
+  data_type_t a_ = data_type(a);
+  data_type_t b_ = data_type(b);
 
-      if (d > (INT64_MAX - c))
-        return ERR_INTEGER_OVERFLOW;
-      vm->stack[vm->sptr - 2] = data_uint(c + d);
-    }
+  if (!(data_type_is_numeric(a_) && data_type_is_numeric(b_)))
+    return ERR_ILLEGAL_TYPE;
 
-    vm->sptr--;
-    vm->iptr++;
-    break;
+  data_numerics_promote_on_float(&a, &a_, &b, &b_);
+
+  // Check if float (if so, just add now)
+  if (a_ == DATA_FLOAT)
+  {
+    *result = data_float(data_as_float(a) + data_as_float(b));
   }
-  case OP_MULT: {
-    if (vm->sptr < 2)
-      return ERR_STACK_UNDERFLOW;
-    data_t *a = vm->stack[vm->sptr - 2];
-    data_t *b = vm->stack[vm->sptr - 1];
+  else if ((a_ == DATA_INT && b_ == DATA_UINT) ||
+           (a_ == DATA_UINT && b_ == DATA_INT))
+  {
+    u64 c = data_as_uint(a_ == DATA_INT ? b : a);
+    i64 d = data_as_int(a_ == DATA_INT ? a : b);
+    if (d > 0 && (c > (UINT60_MAX - d)))
+      // Integer overflow
+      return ERR_INTEGER_OVERFLOW;
+    // Cast to integer
+    else if (d < 0)
+      *result = data_int(c + d);
+    else
+      // Cast to unsigned
+      *result = data_uint(c + d);
+  }
+  else if (a_ == DATA_INT)
+  {
+    i64 c = data_as_int(a);
+    i64 d = data_as_int(b);
+
+    if (c > 0 && (d > (INT60_MAX - c)))
+      return ERR_INTEGER_OVERFLOW;
+    else if (c < 0 && d < (INT60_MIN - c))
+      return ERR_INTEGER_UNDERFLOW;
+    *result = data_int(c + d);
+  }
+  else
+  {
+    u64 c = data_as_uint(a);
+    u64 d = data_as_uint(b);
 
-    data_type_t a_ = data_type(a);
-    data_type_t b_ = data_type(b);
+    if (d > (INT64_MAX - c))
+      return ERR_INTEGER_OVERFLOW;
+    *result = data_uint(c + d);
+  }
 
-    if (!(data_type_is_numeric(a_) && data_type_is_numeric(b_)))
-      return ERR_ILLEGAL_TYPE;
+  return ERR_OK;
+}
 
-    data_numerics_promote_on_float(&a, &a_, &b, &b_);
+err_t vm_mult(data_t *a, data_t *b, data_t **result)
+{
+  data_type_t a_ = data_type(a);
+  data_type_t b_ = data_type(b);
 
-    // Check if float (if so, just add now)
-    if (a_ == DATA_FLOAT)
-    {
-      vm->stack[vm->sptr - 2] = data_float(data_as_float(a) * data_as_float(b));
-    }
-    else if ((a_ == DATA_INT && b_ == DATA_UINT) ||
-             (a_ == DATA_UINT && b_ == DATA_INT))
-    {
-      u64 c = data_as_uint(a_ == DATA_INT ? b : a);
-      i64 d = data_as_int(a_ == DATA_INT ? a : b);
-      if (d > 0 && (c > (UINT60_MAX / d)))
-        // Integer overflow
-        return ERR_INTEGER_OVERFLOW;
-      // Cast to integer
-      else if (d < 0)
-        vm->stack[vm->sptr - 2] = data_int(c * d);
-      else
-        // Cast to unsigned
-        vm->stack[vm->sptr - 2] = data_uint(c * d);
-    }
-    else if (a_ == DATA_INT)
-    {
-      i64 c = data_as_int(a);
-      i64 d = data_as_int(b);
-
-      if (c > 0 && (d > (INT60_MAX / c)))
-        return ERR_INTEGER_OVERFLOW;
-      else if (c < 0 && d < (INT60_MIN / c))
-        return ERR_INTEGER_UNDERFLOW;
-      vm->stack[vm->sptr - 2] = data_int(c * d);
-    }
-    else
-    {
-      u64 c = data_as_uint(a);
-      u64 d = data_as_uint(b);
+  if (!(data_type_is_numeric(a_) && data_type_is_numeric(b_)))
+    return ERR_ILLEGAL_TYPE;
 
-      if (d > (INT64_MAX / c))
-        return ERR_INTEGER_OVERFLOW;
-      vm->stack[vm->sptr - 2] = data_uint(c * d);
-    }
+  data_numerics_promote_on_float(&a, &a_, &b, &b_);
 
-    vm->sptr--;
-    vm->iptr++;
-    break;
+  // Check if float (if so, just add now)
+  if (a_ == DATA_FLOAT)
+  {
+    *result = data_float(data_as_float(a) * data_as_float(b));
   }
-  case OP_DUP:
-    if (vm->sptr == 0)
-      return ERR_STACK_UNDERFLOW;
-    else if (vm->sptr >= VM_STACK_MAX)
-      return ERR_STACK_OVERFLOW;
-    else if (data_type(op.operand) != DATA_UINT)
-      return ERR_ILLEGAL_TYPE;
-    vm->stack[vm->sptr] = vm->stack[vm->sptr - 1 - data_as_uint(op.operand)];
-    vm->sptr++;
-    vm->iptr++;
-    break;
-  case OP_PRINT:
+  else if ((a_ == DATA_INT && b_ == DATA_UINT) ||
+           (a_ == DATA_UINT && b_ == DATA_INT))
+  {
+    u64 c = data_as_uint(a_ == DATA_INT ? b : a);
+    i64 d = data_as_int(a_ == DATA_INT ? a : b);
+    if (d > 0 && (c > (UINT60_MAX / d)))
+      // Integer overflow
+      return ERR_INTEGER_OVERFLOW;
+    // Cast to integer
+    else if (d < 0)
+      *result = data_int(c * d);
+    else
+      // Cast to unsigned
+      *result = data_uint(c * d);
+  }
+  else if (a_ == DATA_INT)
+  {
+    i64 c = data_as_int(a);
+    i64 d = data_as_int(b);
+
+    if (c > 0 && (d > (INT60_MAX / c)))
+      return ERR_INTEGER_OVERFLOW;
+    else if (c < 0 && d < (INT60_MIN / c))
+      return ERR_INTEGER_UNDERFLOW;
+    *result = data_int(c * d);
+  }
+  else
+  {
+    u64 c = data_as_uint(a);
+    u64 d = data_as_uint(b);
+
+    if (d > (INT64_MAX / c))
+      return ERR_INTEGER_OVERFLOW;
+    *result = data_uint(c * d);
+  }
+
+  return ERR_OK;
+}
+
+err_t vm_exec_plus(vm_t *vm, op_t op)
+{
+  (void)op;
+  if (vm->sptr < 2)
+    return ERR_STACK_UNDERFLOW;
+  data_t *result = NULL;
+  err_t err      = vm_plus(vm->stack[vm->sptr - 2], vm->stack[vm->sptr - 1],
+                         &result);
+  if (err != ERR_OK)
+    return err;
+  vm->stack[vm->sptr - 2] = result;
+  vm->sptr--;
+  vm->iptr++;
+  return ERR_OK;
+}
+
+err_t vm_exec_mult(vm_t *vm, op_t op)
+{
+  (void)op;
+  if (vm->sptr < 2)
+    return ERR_STACK_UNDERFLOW;
+  data_t *result = NULL;
+  err_t err      = vm_mult(vm->stack[vm->sptr - 2], vm->stack[vm->sptr - 1],
+                         &result);
+  if (err != ERR_OK)
+    return err;
+  vm->stack[vm->sptr - 2] = result;
+  vm->sptr--;
+  vm->iptr++;
+  return ERR_OK;
+}
+
+err_t vm_exec_dup(vm_t *vm, op_t op)
+{
+  if (vm->sptr == 0)
+    return ERR_STACK_UNDERFLOW;
+  else if (vm->sptr >= VM_STACK_MAX)
+    return ERR_STACK_OVERFLOW;
+  else if (data_type(op.operand) != DATA_UINT)
+    return ERR_ILLEGAL_TYPE;
+  vm->stack[vm->sptr] = vm->stack[vm->sptr - 1 - data_as_uint(op.operand)];
+  vm->sptr++;
+  vm->iptr++;
+  vm->stats.max_sptr = MAX(vm->stats.max_sptr, vm->sptr);
+  return ERR_OK;
+}
+
+err_t vm_exec_print(vm_t *vm, op_t op)
+{
+  (void)op;
+  if (vm->sptr == 0)
+    return ERR_STACK_UNDERFLOW;
+  data_print(vm->stack[vm->sptr - 1], vm->output ? vm->output : stdout);
+  vm->iptr++;
+  vm->stats.prints++;
+  return ERR_OK;
+}
+
+err_t vm_exec_jump(vm_t *vm, op_t op)
+{
+  data_t *operand = op.operand;
+  if (data_type(operand) == DATA_NIL)
+  {
     if (vm->sptr == 0)
       return ERR_STACK_UNDERFLOW;
-    data_print(vm->stack[vm->sptr - 1], stdout);
-    vm->iptr++;
-    break;
-  case OP_JUMP: {
-    data_t *operand = op.operand;
-    if (data_type(operand) == DATA_NIL)
-    {
-      if (vm->sptr == 0)
-        return ERR_STACK_UNDERFLOW;
-      operand = vm->stack[vm->sptr - 1];
-    }
-    data_type_t type = data_type(operand);
+    operand = vm->stack[vm->sptr - 1];
+  }
+  data_type_t type = data_type(operand);
 
-    if (type != DATA_UINT)
-      return ERR_ILLEGAL_TYPE;
-    else if (data_as_uint(operand) > vm->size_program)
-      return ERR_ILLEGAL_JUMP;
+  if (type != DATA_UINT)
+    return ERR_ILLEGAL_TYPE;
+  else if (data_as_uint(operand) > vm->size_program)
+    return ERR_ILLEGAL_JUMP;
 
-    vm->iptr = data_as_uint(operand);
-    if (data_type(op.operand) == DATA_NIL)
-      vm->sptr--;
-    break;
-  }
-  case NUMBER_OF_OPERATORS:
-  default:
-    return ERR_ILLEGAL_INSTRUCTION;
+  vm->iptr = data_as_uint(operand);
+  if (data_type(op.operand) == DATA_NIL)
+  {
+    vm->sptr--;
+    vm->stats.jumps_stack++;
   }
+  else
+    vm->stats.jumps_static++;
   return ERR_OK;
 }
 
+const vm_handler_t VM_DISPATCH[NUMBER_OF_OPERATORS] = {
+    [OP_NONE] = vm_exec_none, [OP_HALT] = vm_exec_halt,
+    [OP_PLUS] = vm_exec_plus, [OP_MULT] = vm_exec_mult,
+    [OP_PRINT] = vm_exec_print, [OP_POP] = vm_exec_pop,
+    [OP_PUSH] = vm_exec_push, [OP_DUP] = vm_exec_dup,
+    [OP_JUMP] = vm_exec_jump,
+};
+
+// Every entry of the hooked table calls the hook before chaining to
+// the real handler
+err_t vm_exec_hooked(vm_t *vm, op_t op)
+{
+  err_t err = vm->hook(vm, op, vm->hook_data);
+  if (err != ERR_OK)
+    return err;
+  return VM_DISPATCH[op.opcode](vm, op);
+}
+
+const vm_handler_t VM_DISPATCH_HOOKED[NUMBER_OF_OPERATORS] = {
+    [OP_NONE] = vm_exec_hooked,  [OP_HALT] = vm_exec_hooked,
+    [OP_PLUS] = vm_exec_hooked,  [OP_MULT] = vm_exec_hooked,
+    [OP_PRINT] = vm_exec_hooked, [OP_POP] = vm_exec_hooked,
+    [OP_PUSH] = vm_exec_hooked,  [OP_DUP] = vm_exec_hooked,
+    [OP_JUMP] = vm_exec_hooked,
+};
+
+void vm_clear_hook(vm_t *vm)
+{
+  vm->hook      = NULL;
+  vm->hook_data = NULL;
+  vm->dispatch  = VM_DISPATCH;
+}
+
+void vm_set_hook(vm_t *vm, vm_hook_t hook, void *data)
+{
+  // No hook is the same as clearing it, rather than a hooked table
+  // calling NULL
+  if (!hook)
+  {
+    vm_clear_hook(vm);
+    return;
+  }
+  vm->hook      = hook;
+  vm->hook_data = data;
+  vm->dispatch  = VM_DISPATCH_HOOKED;
+}
+
+// Execute one instruction, assuming vm->dispatch is set
+err_t vm_step(vm_t *vm)
+{
+  op_t op = vm->program[vm->iptr];
+  if ((u64)op.opcode >= NUMBER_OF_OPERATORS)
+    return ERR_ILLEGAL_INSTRUCTION;
+  err_t err = vm->dispatch[op.opcode](vm, op);
+  if (err == ERR_OK)
+    vm->stats.retired++;
+  return err;
+}
+
+err_t vm_execute(vm_t *vm)
+{
+#if DEBUG
+  vm_print_all(vm, stderr);
+  fputs("\n", stderr);
+#endif
+  if (!vm->dispatch)
+    vm->dispatch = VM_DISPATCH;
+  return vm_step(vm);
+}
+
 err_t vm_execute_all(vm_t *vm)
 {
-  while (vm->program[vm->iptr].opcode != OP_HALT && vm->iptr < vm->size_program)
+  err_t err   = ERR_OK;
+  u64 started = time_now_ns();
+  if (!vm->dispatch)
+    vm->dispatch = VM_DISPATCH;
+  while (vm->iptr < vm->size_program && vm->program[vm->iptr].opcode != OP_HALT)
   {
-    err_t err = vm_execute(vm);
+#if DEBUG
+    vm_print_all(vm, stderr);
+    fputs("\n", stderr);
+#endif
+    err = vm_step(vm);
     if (err != ERR_OK)
-      return err;
+      break;
   }
-  return ERR_OK;
+  vm->stats.wall_ns += time_now_ns() - started;
+  vm->stats.error = err;
+  return err;
+}
+
+err_t vm_execute_n(vm_t *vm, u64 budget)
+{
+  err_t err   = ERR_OK;
+  u64 started = time_now_ns();
+  if (!vm->dispatch)
+    vm->dispatch = VM_DISPATCH;
+  for (; budget > 0 && vm->iptr < vm->size_program &&
+         vm->program[vm->iptr].opcode != OP_HALT;
+       --budget)
+  {
+    err = vm_step(vm);
+    if (err != ERR_OK)
+      break;
+  }
+  vm->stats.wall_ns += time_now_ns() - started;
+  vm->stats.error = err;
+  return err;
+}
+
+void vm_reset(vm_t *vm)
+{
+  vm->iptr  = 0;
+  vm->sptr  = 0;
+  vm->stats = (vm_stats_t){0};
+}
+
+const vm_stats_t *vm_stats(vm_t *vm)
+{
+  return &vm->stats;
+}
+
+void vm_stats_print_json(vm_t *vm, FILE *fp)
+{
+  const vm_stats_t *stats = vm_stats(vm);
+  double ips              = 0;
+  if (stats->wall_ns > 0)
+    ips = stats->retired * 1e9 / stats->wall_ns;
+  fprintf(fp,
+          "{\"instructions\": %" PRIu64 ", \"max_sptr\": %" PRIu64
+          ", \"final_sptr\": %" PRIu64 ", \"jumps\": {\"static\": %" PRIu64
+          ", \"stack\": %" PRIu64 "}, \"prints\": %" PRIu64
+          ", \"error\": \"%s\", \"wall_ns\": %" PRIu64
+          ", \"instructions_per_second\": %.0f}\n",
+          stats->retired, stats->max_sptr, vm->sptr, stats->jumps_static,
+          stats->jumps_stack, stats->prints, err_as_cstr(stats->error),
+          stats->wall_ns, ips);
 }
 
 void vm_copy_program(vm_t *vm, op_t *ops, size_t size_ops)
 {
+  vm->program = reallocarray(vm->program, MAX(size_ops, 1), sizeof(*ops));
   memcpy(vm->program, ops, size_ops * sizeof(*ops));
   vm->size_program = size_ops;
 }
 
+void vm_free(vm_t *vm)
+{
+  free(vm->program);
+  vm->program      = NULL;
+  vm->size_program = 0;
+}
+
 void vm_write_program(vm_t *vm, FILE *fp)
 {
   darr_t bytes = {0};
@@ -344,15 +518,21 @@ err_t read_immediate_from_bytes(buffer_t *buffer, op_t *ret)
 
 err_t vm_read_program(vm_t *vm, buffer_t *buffer)
 {
-  size_t j = 0;
+  size_t j = 0, available = DARR_INITAL_SIZE;
 #if VERBOSE == 1
   size_t prev_bytes = 0;
 #endif
-  while (j < VM_PROGRAM_MAX && buffer_at_end(*buffer) == BUFFER_OK)
+  vm->program = reallocarray(vm->program, available, sizeof(*vm->program));
+  while (buffer_at_end(*buffer) == BUFFER_OK)
   {
 #if VERBOSE == 1
     prev_bytes = buffer->cur;
 #endif
+    if (j == available)
+    {
+      available *= DARR_REALLOC_MULT;
+      vm->program = reallocarray(vm->program, available, sizeof(*vm->program));
+    }
     // first byte is an opcode
     inst_t opcode = buffer_pop(buffer);
     switch (opcode)
@@ -433,9 +613,42 @@ err_t vm_read_program(vm_t *vm, buffer_t *buffer)
 #endif
   }
 
-  if (j == VM_PROGRAM_MAX)
-    assert(false && "vm_read_program: Program is larger than VM_PROGRAM_MAX");
-
   vm->size_program = j;
   return ERR_OK;
 }
+
+err_t vm_verify_program(vm_t *vm, word *at)
+{
+  for (word i = 0; i < vm->size_program; ++i)
+  {
+    op_t op = vm->program[i];
+    *at     = i;
+    switch (op.opcode)
+    {
+    case OP_NONE:
+    case OP_HALT:
+    case OP_PLUS:
+    case OP_MULT:
+    case OP_PRINT:
+    case OP_POP:
+    case OP_PUSH:
+      break;
+    case OP_DUP:
+      if (data_type(op.operand) != DATA_UINT)
+        return ERR_ILLEGAL_TYPE;
+      break;
+    case OP_JUMP:
+      if (data_type(op.operand) == DATA_NIL)
+        break;
+      else if (data_type(op.operand) != DATA_UINT)
+        return ERR_ILLEGAL_TYPE;
+      else if (data_as_uint(op.operand) > vm->size_program)
+        return ERR_ILLEGAL_JUMP;
+      break;
+    case NUMBER_OF_OPERATORS:
+    default:
+      return ERR_ILLEGAL_INSTRUCTION;
+    }
+  }
+  return ERR_OK;
+}
@@ -5,25 +5,81 @@
 #include "./lib.h"
 #include "./op.h"
 
-#define VM_STACK_MAX   1024
-#define VM_PROGRAM_MAX 1024
+#define VM_STACK_MAX 1024
 
+/* Runtime statistics, always collected.  Relative jumps are resolved
+ * to absolute addresses by the assembler so they count as static
+ * jumps here. */
 typedef struct
 {
-  op_t program[VM_PROGRAM_MAX];
+  u64 retired, max_sptr, prints;
+  u64 jumps_static, jumps_stack;
+  u64 wall_ns;
+  err_t error;
+} vm_stats_t;
+
+typedef struct VM vm_t;
+
+/* Instructions are executed through a per-VM table of handlers, one
+ * per opcode.  Setting a hook swaps in a table whose handlers call the
+ * hook and then chain to the real handler, so a VM without hooks pays
+ * nothing for them.  A hook returning anything but ERR_OK stops
+ * execution with that error before the instruction is executed. */
+typedef err_t (*vm_handler_t)(vm_t *, op_t);
+typedef err_t (*vm_hook_t)(vm_t *, op_t, void *);
+
+extern const vm_handler_t VM_DISPATCH[NUMBER_OF_OPERATORS];
+extern const vm_handler_t VM_DISPATCH_HOOKED[NUMBER_OF_OPERATORS];
+
+struct VM
+{
+  // Owned by the VM, see vm_free
+  op_t *program;
   word iptr, size_program;
 
   data_t *stack[VM_STACK_MAX];
   word sptr;
-} vm_t;
+
+  vm_stats_t stats;
+  // Where OP_PRINT writes to, NULL is treated as stdout
+  FILE *output;
+
+  // NULL is treated as VM_DISPATCH
+  const vm_handler_t *dispatch;
+  vm_hook_t hook;
+  void *hook_data;
+};
 
 void vm_print_all(vm_t *vm, FILE *fp);
 
+/* Arithmetic of OP_PLUS and OP_MULT on a (below) and b (on top of the
+ * stack), including promotion and overflow checks.  On success *result
+ * is set, otherwise the stack should be left as it was. */
+err_t vm_plus(data_t *a, data_t *b, data_t **result);
+err_t vm_mult(data_t *a, data_t *b, data_t **result);
+
 err_t vm_execute(vm_t *vm);
 err_t vm_execute_all(vm_t *vm);
+// Execute at most budget instructions, stopping early on OP_HALT, the
+// end of the program or an error
+err_t vm_execute_n(vm_t *vm, u64 budget);
+// Rewind execution (instruction pointer, stack and statistics) while
+// keeping the program, output and hooks
+void vm_reset(vm_t *vm);
+
+// A NULL hook is the same as vm_clear_hook
+void vm_set_hook(vm_t *vm, vm_hook_t hook, void *data);
+void vm_clear_hook(vm_t *vm);
+
+const vm_stats_t *vm_stats(vm_t *vm);
+void vm_stats_print_json(vm_t *vm, FILE *fp);
 
 void vm_copy_program(vm_t *vm, op_t *ops, size_t size_ops);
+void vm_free(vm_t *vm);
 void vm_write_program(vm_t *vm, FILE *fp);
 err_t vm_read_program(vm_t *vm, buffer_t *buffer);
+// Checks what can be checked before execution: opcodes, operand types
+// and static jump targets.  On failure, *at is the offending address.
+err_t vm_verify_program(vm_t *vm, word *at);
 
 #endif
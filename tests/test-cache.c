@@ -0,0 +1,129 @@
+/* test-cache.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Unit tests for cache.h
+ */
+
+#include "./test-cache.h"
+#include "./test.h"
+
+#include "../src/cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CACHE_MOCK_FILE    "tests/TEST_CACHE_MOCK_FILE.txt"
+#define CACHE_MOCK_REGIONS 4
+
+// A source of CACHE_MOCK_REGIONS regions, each jumping to the next
+buffer_t cache_mock_source(void)
+{
+  darr_t text = {0};
+  darr_init(&text, DARR_INITAL_SIZE, 1);
+  char line[64];
+  for (size_t i = 0; i < CACHE_MOCK_REGIONS; ++i)
+  {
+    int size = sprintf(line, "label region-%c\n", (char)('a' + i));
+    darr_mem_append(&text, line, size);
+    // Enough lines that every label starts a region of its own
+    for (size_t j = 0; j < CACHE_MIN_REGION / 8; ++j)
+    {
+      size = sprintf(line, "  push %lu\n  pop\n", j % 10);
+      darr_mem_append(&text, line, size);
+    }
+    size = sprintf(line, "  jmp region-%c\n", (char)('a' + (i + 1) % CACHE_MOCK_REGIONS));
+    darr_mem_append(&text, line, size);
+  }
+  buffer_t buffer = buffer_read_cstr("*test-cache*", text.data, text.used);
+  darr_free(&text);
+  return buffer;
+}
+
+// Whether assembling buffer through the cache gives the same program
+// as assembling it as a whole, with stats from the cache
+bool cache_matches(buffer_t *buffer, cache_stats_t *stats)
+{
+  op_t *cached = NULL, *expected = NULL;
+  u64 cached_size = 0, expected_size = 0;
+  if (!cache_assemble(buffer, CACHE_MOCK_FILE, &cached, &cached_size, stats))
+    return false;
+
+  // Lexing leaves the cursor at the end
+  buffer->cur     = 0;
+  stream_t stream = {0};
+  bool matches    = tokenise_buffer(&stream, buffer) == LERR_OK;
+  matches = matches && parse_stream(&stream, &expected, &expected_size) ==
+                           PERR_OK;
+  matches = matches && cached_size == expected_size;
+  for (u64 i = 0; matches && i < expected_size; ++i)
+    matches = cached[i].opcode == expected[i].opcode &&
+              cached[i].operand == expected[i].operand;
+
+  stream_free(&stream);
+  free(expected);
+  free(cached);
+  return matches;
+}
+
+bool test_cache_reuse(void)
+{
+  buffer_t buffer     = cache_mock_source();
+  cache_stats_t stats = {0};
+  remove(CACHE_MOCK_FILE);
+
+  ASSERT(test_reuse_fresh, cache_matches(&buffer, &stats) &&
+                               stats.regions == CACHE_MOCK_REGIONS &&
+                               stats.reused == 0);
+  ASSERT(test_reuse_all, cache_matches(&buffer, &stats) &&
+                             stats.regions == CACHE_MOCK_REGIONS &&
+                             stats.reused == CACHE_MOCK_REGIONS);
+
+  remove(CACHE_MOCK_FILE);
+  free(buffer.data);
+  return test_reuse_fresh && test_reuse_all;
+}
+
+bool test_cache_edit(void)
+{
+  buffer_t buffer     = cache_mock_source();
+  cache_stats_t stats = {0};
+  remove(CACHE_MOCK_FILE);
+  cache_matches(&buffer, &stats);
+
+  // Same size, different text, in the second region only
+  char *second = strstr(buffer.data, "label region-b");
+  char *digit  = strstr(second, "push 3") + 5;
+  *digit       = '7';
+  ASSERT(test_edit_one, cache_matches(&buffer, &stats) &&
+                            stats.reused == CACHE_MOCK_REGIONS - 1);
+  ASSERT(test_edit_kept, cache_matches(&buffer, &stats) &&
+                             stats.reused == CACHE_MOCK_REGIONS);
+
+  remove(CACHE_MOCK_FILE);
+  free(buffer.data);
+  return test_edit_one && test_edit_kept;
+}
+
+bool test_cache_revision(void)
+{
+  buffer_t buffer     = cache_mock_source();
+  cache_stats_t stats = {0};
+  remove(CACHE_MOCK_FILE);
+  cache_matches(&buffer, &stats);
+
+  // Pretend the cache was made by a parser of another revision
+  word revision = PARSER_REVISION + 1;
+  FILE *fp      = fopen(CACHE_MOCK_FILE, "r+b");
+  fseek(fp, sizeof(CACHE_MAGIC) - 1 + sizeof(word), SEEK_SET);
+  fwrite(&revision, sizeof(revision), 1, fp);
+  fclose(fp);
+
+  ASSERT(test_revision_ignored,
+         cache_matches(&buffer, &stats) && stats.reused == 0);
+  ASSERT(test_revision_rewritten, cache_matches(&buffer, &stats) &&
+                                      stats.reused == CACHE_MOCK_REGIONS);
+
+  remove(CACHE_MOCK_FILE);
+  free(buffer.data);
+  return test_revision_ignored && test_revision_rewritten;
+}
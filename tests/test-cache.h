@@ -0,0 +1,16 @@
+#ifndef TEST_CACHE_H
+#define TEST_CACHE_H
+
+#include "./test.h"
+
+bool test_cache_reuse(void);
+bool test_cache_edit(void);
+bool test_cache_revision(void);
+
+static const test_t TEST_CACHE_SUITE[] = {
+    CREATE_TEST(test_cache_reuse),
+    CREATE_TEST(test_cache_edit),
+    CREATE_TEST(test_cache_revision),
+};
+
+#endif
@@ -0,0 +1,134 @@
+/* test-cfg.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Unit tests for cfg.h
+ */
+
+#include "./test-cfg.h"
+#include "./test.h"
+
+#include "../src/cfg.h"
+
+#define JMP(N) OP_CREATE_JMP(data_uint(N))
+
+bool test_cfg_blocks(void)
+{
+  // 0: push 1, 1: jmp 3, 2: print, 3: plus, 4: halt, 5: noop
+  op_t program[] = {OP_CREATE_PUSH(data_int(1)), JMP(3),
+                    OP_CREATE_PRINT,             OP_CREATE_PLUS,
+                    OP_CREATE_HALT,              OP_CREATE_NOOP};
+  cfg_t cfg = {0};
+  cfg_init(&cfg, program, ARR_SIZE(program), NULL);
+
+  // Leaders: the entry, after the jump, its target and after the halt
+  ASSERT(test_blocks_count, cfg.blocks == 4);
+  ASSERT(test_blocks_leaders, cfg.leaders[0] == 0 && cfg.leaders[1] == 2 &&
+                                  cfg.leaders[2] == 3 && cfg.leaders[3] == 5);
+  ASSERT(test_blocks_block_of,
+         cfg.block_of[1] == 0 && cfg.block_of[4] == 2 && cfg.block_of[5] == 3);
+  // Jump, fall through, then nothing after the halt
+  ASSERT(test_blocks_succs, cfg.succ_start[1] - cfg.succ_start[0] == 1 &&
+                                cfg.succs[cfg.succ_start[0]] == 2 &&
+                                cfg.succs[cfg.succ_start[1]] == 2 &&
+                                cfg.succ_start[3] == cfg.succ_start[2]);
+  ASSERT(test_blocks_preds, cfg.pred_start[3] - cfg.pred_start[2] == 2 &&
+                                cfg.pred_start[1] == cfg.pred_start[0]);
+  ASSERT(test_blocks_unreachable, cfg.reachable == 2 &&
+                                      cfg.idom[1] == CFG_NONE &&
+                                      cfg.idom[3] == CFG_NONE);
+
+  cfg_free(&cfg);
+  return test_blocks_count && test_blocks_leaders && test_blocks_block_of &&
+         test_blocks_succs && test_blocks_preds && test_blocks_unreachable;
+}
+
+bool test_cfg_dominators(void)
+{
+  // 3 is also fallen into from 2, which is never reached
+  // 0: jmp 3, 1: jmp 4, 2: noop, 3: print, 4: halt
+  op_t program[] = {JMP(3), JMP(4), OP_CREATE_NOOP, OP_CREATE_PRINT,
+                    OP_CREATE_HALT};
+  cfg_t cfg = {0};
+  cfg_init(&cfg, program, ARR_SIZE(program), NULL);
+
+  size_t entry = cfg.block_of[0], print = cfg.block_of[3];
+  size_t halt = cfg.block_of[4];
+  ASSERT(test_dominators_entry, cfg.idom[entry] == entry);
+  ASSERT(test_dominators_idom,
+         cfg.idom[print] == entry && cfg.idom[halt] == print);
+  ASSERT(test_dominators_query, cfg_dominates(&cfg, entry, halt) &&
+                                    cfg_dominates(&cfg, halt, halt) &&
+                                    !cfg_dominates(&cfg, halt, print));
+  ASSERT(test_dominators_unreachable,
+         !cfg_dominates(&cfg, entry, cfg.block_of[1]));
+
+  cfg_free(&cfg);
+  return test_dominators_entry && test_dominators_idom &&
+         test_dominators_query && test_dominators_unreachable;
+}
+
+bool test_cfg_loops(void)
+{
+  // 0: noop, 1: print, 2: jmp 4, 3: jmp 1, 4: plus, 5: jmp 3
+  op_t program[] = {OP_CREATE_NOOP, OP_CREATE_PRINT, JMP(4),
+                    JMP(1),         OP_CREATE_PLUS,  JMP(3)};
+  cfg_t cfg = {0};
+  cfg_init(&cfg, program, ARR_SIZE(program), NULL);
+
+  size_t entry = cfg.block_of[0], header = cfg.block_of[1];
+  size_t back = cfg.block_of[3], body = cfg.block_of[4];
+  ASSERT(test_loops_header, cfg.loop_header[header] == header &&
+                                cfg.loop_header[back] == header &&
+                                cfg.loop_header[body] == header);
+  ASSERT(test_loops_outside, cfg.loop_header[entry] == CFG_NONE &&
+                                 cfg.loop_depth[entry] == 0);
+  ASSERT(test_loops_depth, cfg.loop_depth[header] == 1 &&
+                               cfg.loop_depth[body] == 1 &&
+                               cfg.loop_parent[header] == CFG_NONE);
+  cfg_free(&cfg);
+
+  // 0: noop, 1: jmp 1
+  op_t self[] = {OP_CREATE_NOOP, JMP(1)};
+  cfg_init(&cfg, self, ARR_SIZE(self), NULL);
+  size_t loop = cfg.block_of[1];
+  ASSERT(test_loops_self,
+         cfg.loop_header[loop] == loop && cfg.loop_depth[loop] == 1);
+  cfg_free(&cfg);
+
+  return test_loops_header && test_loops_outside && test_loops_depth &&
+         test_loops_self;
+}
+
+bool test_cfg_return_sites(void)
+{
+  // 0: push *1 (as 2), 1: jmp 3, 2: halt, 3: jmp *
+  op_t program[] = {OP_CREATE_PUSH(data_uint(2)), JMP(3), OP_CREATE_HALT,
+                    OP_CREATE_JMP(data_nil())};
+  bool relocated[] = {true, true, false, false};
+  cfg_t cfg        = {0};
+  cfg_init(&cfg, program, ARR_SIZE(program), relocated);
+
+  size_t site = cfg.block_of[2], call = cfg.block_of[3];
+  ASSERT(test_return_sites_leader, cfg.leaders[site] == 2 && cfg.returns[site]);
+  ASSERT(test_return_sites_dynamic, cfg.dynamic[call] &&
+                                        cfg.succ_start[call + 1] ==
+                                            cfg.succ_start[call]);
+  // Return sites are entry points, so reachable and their own dominator
+  ASSERT(test_return_sites_entry, cfg.idom[site] == site);
+  cfg_free(&cfg);
+
+  // A uint literal the relocations say isn't `push *N` is not a return
+  // site, but without any relocations every pushed uint may be one
+  relocated[0] = false;
+  cfg_init(&cfg, program, ARR_SIZE(program), relocated);
+  ASSERT(test_return_sites_literal, !cfg.returns[cfg.block_of[2]] &&
+                                        cfg.idom[cfg.block_of[2]] == CFG_NONE);
+  cfg_free(&cfg);
+  cfg_init(&cfg, program, ARR_SIZE(program), NULL);
+  ASSERT(test_return_sites_conservative, cfg.returns[cfg.block_of[2]]);
+  cfg_free(&cfg);
+
+  return test_return_sites_leader && test_return_sites_dynamic &&
+         test_return_sites_entry && test_return_sites_literal &&
+         test_return_sites_conservative;
+}
@@ -0,0 +1,18 @@
+#ifndef TEST_CFG_H
+#define TEST_CFG_H
+
+#include "./test.h"
+
+bool test_cfg_blocks(void);
+bool test_cfg_dominators(void);
+bool test_cfg_loops(void);
+bool test_cfg_return_sites(void);
+
+static const test_t TEST_CFG_SUITE[] = {
+    CREATE_TEST(test_cfg_blocks),
+    CREATE_TEST(test_cfg_dominators),
+    CREATE_TEST(test_cfg_loops),
+    CREATE_TEST(test_cfg_return_sites),
+};
+
+#endif
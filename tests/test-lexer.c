@@ -10,6 +10,14 @@
 #include <assert.h>
 #include <string.h>
 
+bool stream_position_is(stream_t *stream, size_t index, size_t line,
+                        size_t column)
+{
+  size_t actual_line = 0, actual_column = 0;
+  return stream_position(stream, index, &actual_line, &actual_column) &&
+         actual_line == line && actual_column == column;
+}
+
 bool test_tokenise_one_character(void)
 {
   static_assert(TOKEN_WHITESPACE == 5,
@@ -32,9 +40,9 @@ bool test_tokenise_one_character(void)
     printf("\t");
     ASSERT(test_eof_buffer_parsed, stream.size == 2);
     printf("\t");
-    ASSERT(test_eof_lexeme_first_is_eof, stream.tokens[0].type == TOKEN_EOF);
+    ASSERT(test_eof_lexeme_first_is_eof, stream.types[0] == TOKEN_EOF);
     printf("\t");
-    ASSERT(test_eof_lexeme_second_is_eof, stream.tokens[1].type == TOKEN_EOF);
+    ASSERT(test_eof_lexeme_second_is_eof, stream.types[1] == TOKEN_EOF);
     test_eof = test_eof_no_lerr & test_eof_buffer_parsed &
                test_eof_lexeme_first_is_eof & test_eof_lexeme_second_is_eof;
     LOG_TEST_STATUS(test_eof, test_eof_ *);
@@ -55,9 +63,9 @@ bool test_tokenise_one_character(void)
     printf("\t");
     ASSERT(test_dot_buffer_parsed, stream.size == 2);
     printf("\t");
-    ASSERT(test_dot_lexeme_first_is_dot, stream.tokens[0].type == TOKEN_DOT);
+    ASSERT(test_dot_lexeme_first_is_dot, stream.types[0] == TOKEN_DOT);
     printf("\t");
-    ASSERT(test_dot_lexeme_second_is_eof, stream.tokens[1].type == TOKEN_EOF);
+    ASSERT(test_dot_lexeme_second_is_eof, stream.types[1] == TOKEN_EOF);
     test_dot = test_dot_no_lerr & test_dot_buffer_parsed &
                test_dot_lexeme_first_is_dot & test_dot_lexeme_second_is_eof;
     LOG_TEST_STATUS(test_dot, test_dot_ *);
@@ -78,9 +86,9 @@ bool test_tokenise_one_character(void)
     printf("\t");
     ASSERT(test_dash_buffer_parsed, stream.size == 2);
     printf("\t");
-    ASSERT(test_dash_lexeme_first_is_dash, stream.tokens[0].type == TOKEN_DASH);
+    ASSERT(test_dash_lexeme_first_is_dash, stream.types[0] == TOKEN_DASH);
     printf("\t");
-    ASSERT(test_dash_lexeme_second_is_eof, stream.tokens[1].type == TOKEN_EOF);
+    ASSERT(test_dash_lexeme_second_is_eof, stream.types[1] == TOKEN_EOF);
     test_dash = test_dash_no_lerr & test_dash_buffer_parsed &
                 test_dash_lexeme_first_is_dash & test_dash_lexeme_second_is_eof;
     LOG_TEST_STATUS(test_dash, test_dash *);
@@ -101,9 +109,9 @@ bool test_tokenise_one_character(void)
     printf("\t");
     ASSERT(test_hat_buffer_parsed, stream.size == 2);
     printf("\t");
-    ASSERT(test_hat_lexeme_first_is_hat, stream.tokens[0].type == TOKEN_HAT);
+    ASSERT(test_hat_lexeme_first_is_hat, stream.types[0] == TOKEN_HAT);
     printf("\t");
-    ASSERT(test_hat_lexeme_second_is_eof, stream.tokens[1].type == TOKEN_EOF);
+    ASSERT(test_hat_lexeme_second_is_eof, stream.types[1] == TOKEN_EOF);
     test_hat = test_hat_no_lerr & test_hat_buffer_parsed &
                test_hat_lexeme_first_is_hat & test_hat_lexeme_second_is_eof;
     LOG_TEST_STATUS(test_hat, test_hat *);
@@ -123,9 +131,9 @@ bool test_tokenise_one_character(void)
     printf("\t");
     ASSERT(test_star_buffer_parsed, stream.size == 2);
     printf("\t");
-    ASSERT(test_star_lexeme_first_is_star, stream.tokens[0].type == TOKEN_STAR);
+    ASSERT(test_star_lexeme_first_is_star, stream.types[0] == TOKEN_STAR);
     printf("\t");
-    ASSERT(test_star_lexeme_second_is_eof, stream.tokens[1].type == TOKEN_EOF);
+    ASSERT(test_star_lexeme_second_is_eof, stream.types[1] == TOKEN_EOF);
     test_star = test_star_no_lerr & test_star_buffer_parsed &
                 test_star_lexeme_first_is_star & test_star_lexeme_second_is_eof;
     LOG_TEST_STATUS(test_star, test_star *);
@@ -155,7 +163,7 @@ bool test_tokenise_whitespace(void)
 
     printf("\t");
     ASSERT(test_whitespace_variety_only_whitespace,
-           stream.size == 2 && stream.tokens[0].type == TOKEN_WHITESPACE);
+           stream.size == 2 && stream.types[0] == TOKEN_WHITESPACE);
 
     test_whitespace_variety = test_whitespace_variety_only_whitespace &
                               test_whitespace_variety_no_lerr;
@@ -182,23 +190,23 @@ bool test_tokenise_whitespace(void)
 
     printf("\t");
     ASSERT(test_whitespace_chunks_first_token_is_whitespace,
-           stream.tokens[0].type == TOKEN_WHITESPACE);
+           stream.types[0] == TOKEN_WHITESPACE);
     printf("\t");
     ASSERT(test_whitespace_chunks_third_token_is_whitespace,
-           stream.tokens[2].type == TOKEN_WHITESPACE);
+           stream.types[2] == TOKEN_WHITESPACE);
     printf("\t");
     ASSERT(test_whitespace_chunks_fifth_token_is_whitespace,
-           stream.tokens[4].type == TOKEN_WHITESPACE);
+           stream.types[4] == TOKEN_WHITESPACE);
 
     printf("\t");
     ASSERT(test_whitespace_chunks_first_whitespace_col_line,
-           stream.tokens[0].column == 0 && stream.tokens[0].line == 1);
+           stream_position_is(&stream, 0, 1, 0));
     printf("\t");
     ASSERT(test_whitespace_chunks_third_whitespace_col_line,
-           stream.tokens[2].column == 17 && stream.tokens[2].line == 2);
+           stream_position_is(&stream, 2, 2, 17));
     printf("\t");
     ASSERT(test_whitespace_chunks_fifth_whitespace_col_line,
-           stream.tokens[4].column == 10 && stream.tokens[4].line == 3);
+           stream_position_is(&stream, 4, 3, 10));
 
     test_whitespace_chunks = test_whitespace_chunks_no_lerr &
                              test_whitespace_chunks_seven_chunks &
@@ -232,26 +240,23 @@ bool test_tokenise_symbol(void)
   ASSERT(test_symbol_no_lerr, lerr == LERR_OK);
   ASSERT(test_symbol_expected_number_tokens, stream.size == 6);
 
-  ASSERT(test_symbol_first_is_symbol, stream.tokens[0].type == TOKEN_SYMBOL);
+  ASSERT(test_symbol_first_is_symbol, stream.types[0] == TOKEN_SYMBOL);
   ASSERT(test_symbol_first_is_correct_symbol,
-         strncmp(stream.tokens[0].content, expected_symbols[0],
-                 stream.tokens[0].size) == 0);
-  ASSERT(test_symbol_first_in_correct_column, stream.tokens[0].column == 0);
-  ASSERT(test_symbol_first_in_correct_line, stream.tokens[0].line == 1);
+         token_equals(&stream, stream_token(&stream, 0), expected_symbols[0]));
+  ASSERT(test_symbol_first_in_correct_position,
+         stream_position_is(&stream, 0, 1, 0));
 
-  ASSERT(test_symbol_third_is_symbol, stream.tokens[2].type == TOKEN_SYMBOL);
+  ASSERT(test_symbol_third_is_symbol, stream.types[2] == TOKEN_SYMBOL);
   ASSERT(test_symbol_third_is_correct_symbol,
-         strncmp(stream.tokens[2].content, expected_symbols[1],
-                 stream.tokens[2].size) == 0);
-  ASSERT(test_symbol_third_in_correct_column, stream.tokens[2].column == 17);
-  ASSERT(test_symbol_third_in_correct_line, stream.tokens[2].line == 1);
+         token_equals(&stream, stream_token(&stream, 2), expected_symbols[1]));
+  ASSERT(test_symbol_third_in_correct_position,
+         stream_position_is(&stream, 2, 1, 17));
 
-  ASSERT(test_symbol_fifth_is_symbol, stream.tokens[4].type == TOKEN_SYMBOL);
+  ASSERT(test_symbol_fifth_is_symbol, stream.types[4] == TOKEN_SYMBOL);
   ASSERT(test_symbol_fifth_is_correct_symbol,
-         strncmp(stream.tokens[4].content, expected_symbols[2],
-                 stream.tokens[4].size) == 0);
-  ASSERT(test_symbol_fifth_in_correct_column, stream.tokens[4].column == 0);
-  ASSERT(test_symbol_fifth_in_correct_line, stream.tokens[4].line == 2);
+         token_equals(&stream, stream_token(&stream, 4), expected_symbols[2]));
+  ASSERT(test_symbol_fifth_in_correct_position,
+         stream_position_is(&stream, 4, 2, 0));
 
   free(buffer.data);
   stream_free(&stream);
@@ -260,12 +265,9 @@ bool test_tokenise_symbol(void)
          test_symbol_first_is_symbol & test_symbol_first_is_correct_symbol &
          test_symbol_third_is_symbol & test_symbol_third_is_correct_symbol &
          test_symbol_fifth_is_symbol & test_symbol_fifth_is_correct_symbol &
-         test_symbol_first_in_correct_column &
-         test_symbol_first_in_correct_line &
-         test_symbol_third_in_correct_column &
-         test_symbol_third_in_correct_line &
-         test_symbol_fifth_in_correct_column &
-         test_symbol_fifth_in_correct_line;
+         test_symbol_first_in_correct_position &
+         test_symbol_third_in_correct_position &
+         test_symbol_fifth_in_correct_position;
 }
 
 bool test_tokenise_character(void)
@@ -290,10 +292,10 @@ bool test_tokenise_character(void)
     for (size_t i = 0, j = 0; i < stream.size; i += 2, j += 1)
     {
       printf("\t\t");
-      ASSERT(test_ith_escape_type, stream.tokens[i].type == TOKEN_CHARACTER);
+      ASSERT(test_ith_escape_type, stream.types[i] == TOKEN_CHARACTER);
       printf("\t\t");
       ASSERT(test_ith_escape_expected_literal,
-             stream.tokens[i].content[0] == expected[j]);
+             token_as_char(&stream, stream_token(&stream, i)) == expected[j]);
 
       test_escape_expected_escapes *=
           test_ith_escape_type & test_ith_escape_expected_literal;
@@ -323,10 +325,10 @@ bool test_tokenise_character(void)
     for (size_t i = 0, j = 0; i < stream.size; i += 2, j += 1)
     {
       printf("\t\t");
-      ASSERT(test_ith_general_type, stream.tokens[i].type == TOKEN_CHARACTER);
+      ASSERT(test_ith_general_type, stream.types[i] == TOKEN_CHARACTER);
       printf("\t\t");
       ASSERT(test_ith_general_expected_literal,
-             stream.tokens[i].content[0] == expected[j]);
+             token_as_char(&stream, stream_token(&stream, i)) == expected[j]);
 
       test_general_expected_characters *=
           test_ith_general_type & test_ith_general_expected_literal;
@@ -371,11 +373,11 @@ bool test_tokenise_number(void)
     for (size_t i = 0, j = 0; i < stream.size; i += 2, j += 1)
     {
       printf("\t\t");
-      ASSERT(test_ith_integral_type, stream.tokens[i].type == TOKEN_NUMBER);
+      ASSERT(test_ith_integral_type, stream.types[i] == TOKEN_NUMBER);
       printf("\t\t");
       ASSERT(test_ith_integral_expected_literal,
-             strncmp(stream.tokens[i].content, expected_output[j],
-                     stream.tokens[i].size) == 0);
+             token_equals(&stream, stream_token(&stream, i),
+                          expected_output[j]));
 
       test_integral_expected_numbers *=
           test_ith_integral_type & test_ith_integral_expected_literal;
@@ -410,11 +412,11 @@ bool test_tokenise_number(void)
     {
       printf("\t\t");
       ASSERT(test_ith_floating_point_type,
-             stream.tokens[i].type == TOKEN_NUMBER);
+             stream.types[i] == TOKEN_NUMBER);
       printf("\t\t");
       ASSERT(test_ith_floating_point_expected_literal,
-             strncmp(stream.tokens[i].content, expected_output[j],
-                     stream.tokens[i].size) == 0);
+             token_equals(&stream, stream_token(&stream, i),
+                          expected_output[j]));
 
       test_floating_point_expected_numbers *=
           test_ith_floating_point_type &
@@ -430,7 +432,93 @@ bool test_tokenise_number(void)
   }
   LOG_TEST_STATUS(test_floating_point_values, _);
 
-  return test_integral_values & test_floating_point_values;
+  // Values and flags are computed by the lexer, in any base
+  bool test_number_values = true;
+  LOG_TEST_START(test_number_values);
+  {
+    const char *test_input = "0x1F -0b101 1_000_000 0xFF_FF 2.5 "
+                             "18446744073709551616 0x1_0000_0000_0000_0000";
+    const struct
+    {
+      u64 integer;
+      float real;
+      byte flags;
+    } expected[] = {
+        {0x1F, 31.0f, 0},
+        {5, 5.0f, NUMBER_NEGATIVE},
+        {1000000, 1e6f, 0},
+        {0xFFFF, 65535.0f, 0},
+        {25, 2.5f, NUMBER_POINT},
+        {0, 18446744073709551616.0f, NUMBER_OVERFLOW},
+        {0, 18446744073709551616.0f, NUMBER_OVERFLOW},
+    };
+    buffer      = buffer_read_cstr(name, test_input, strlen(test_input));
+    lerr_t lerr = tokenise_buffer(&stream, &buffer);
+
+    printf("\t");
+    ASSERT(test_values_no_lerr, lerr == LERR_OK);
+    printf("\t");
+    ASSERT(test_values_expected_amount, stream.size == ARR_SIZE(expected) * 2);
+
+    bool test_values_expected = true;
+    for (size_t i = 0, j = 0; j < ARR_SIZE(expected) && i < stream.size;
+         i += 2, j += 1)
+    {
+      number_t number = stream_token(&stream, i).number;
+      printf("\t\t");
+      ASSERT(test_ith_value, number.flags == expected[j].flags &&
+                                 number.real == expected[j].real &&
+                                 (number.flags & NUMBER_OVERFLOW ||
+                                  number.integer == expected[j].integer));
+      test_values_expected &= test_ith_value;
+    }
+
+    free(buffer.data);
+    stream_free(&stream);
+
+    // Separators only go between digits and prefixes need digits
+    const char *malformed[]  = {"1_", "1__0", "1_.5", "0x", "0b2"};
+    bool test_malformed_lerr = true;
+    for (size_t i = 0; i < ARR_SIZE(malformed); ++i)
+    {
+      buffer = buffer_read_cstr(name, malformed[i], strlen(malformed[i]));
+      test_malformed_lerr &=
+          tokenise_buffer(&stream, &buffer) == LERR_NUMBER_MALFORMED;
+      free(buffer.data);
+    }
+    printf("\t");
+    ASSERT(test_malformed_numbers, test_malformed_lerr);
+
+    // Decimals round the same as strtof, on the fast path or not
+    bool test_reals_match = true;
+    char literal[64]      = {0};
+    u64 state             = 0x9E3779B97F4A7C15LU;
+    for (size_t i = 0; i < 10000; ++i)
+    {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      int digits = 1 + (state >> 32) % 12;
+      u64 scale  = 1;
+      for (int d = 0; d < digits; ++d)
+        scale *= 10;
+      snprintf(literal, sizeof(literal), "%" PRIu64 ".%0*" PRIu64,
+               state % 1000000000, digits, (state >> 16) % scale);
+      number_t number = {0};
+      lexer_number(literal, strlen(literal), &number);
+      test_reals_match &= number.real == strtof(literal, NULL);
+    }
+    printf("\t");
+    ASSERT(test_reals_match_strtof, test_reals_match);
+
+    test_number_values = test_values_no_lerr & test_values_expected_amount &
+                         test_values_expected & test_malformed_numbers &
+                         test_reals_match_strtof;
+  }
+  LOG_TEST_STATUS(test_number_values, _);
+
+  return test_integral_values & test_floating_point_values &
+         test_number_values;
 }
 
 bool test_tokenise_comments(void)
@@ -458,8 +546,8 @@ bool test_tokenise_comments(void)
     {
       printf("\t");
       ASSERT(test_ith_comment_doc_string,
-             strncmp(stream.tokens[i].content, expected_comments[j],
-                     stream.tokens[i].size) == 0);
+             token_equals(&stream, stream_token(&stream, i),
+                          expected_comments[j]));
       test_comment_doc_string &= test_ith_comment_doc_string;
     }
 
@@ -484,12 +572,12 @@ bool test_tokenise_comments(void)
 
     for (size_t i = 0, j = 0; i < stream.size; ++i)
     {
-      if (stream.tokens[i].type == TOKEN_COMMENT)
+      if (stream.types[i] == TOKEN_COMMENT)
       {
         printf("\t");
         ASSERT(test_ith_comment_inline,
-               strncmp(stream.tokens[i].content, expected_comments[j++],
-                       stream.tokens[i].size) == 0);
+               token_equals(&stream, stream_token(&stream, i),
+                            expected_comments[j++]));
         test_comment_inline &= test_ith_comment_inline;
       }
     }
@@ -500,3 +588,243 @@ bool test_tokenise_comments(void)
   LOG_TEST_STATUS(test_comment_inline, _);
   return test_comment_doc_string & test_comment_inline;
 }
+
+bool test_tokenise_growth(void)
+{
+  const char *name = "test-growth";
+  stream_t stream  = {0};
+
+  // No whitespace so the estimate of the number of tokens is too small,
+  // forcing the stream to grow
+  char input[200] = {0};
+  for (size_t i = 0; i < ARR_SIZE(input); i += 2)
+  {
+    input[i]     = 'a';
+    input[i + 1] = '*';
+  }
+  buffer_t buffer = buffer_read_cstr(name, input, ARR_SIZE(input));
+  lerr_t lerr     = tokenise_buffer(&stream, &buffer);
+
+  ASSERT(test_growth_no_lerr, lerr == LERR_OK);
+  // Including the terminating EOF
+  ASSERT(test_growth_expected_number, stream.size == ARR_SIZE(input) + 1);
+  bool expected_tokens = stream.size == ARR_SIZE(input) + 1;
+  for (size_t i = 0; expected_tokens && i < ARR_SIZE(input); ++i)
+  {
+    token_t token = stream_token(&stream, i);
+    expected_tokens &=
+        token.type == (i % 2 == 0 ? TOKEN_SYMBOL : TOKEN_STAR) &&
+        token.offset == i && token.size == 1;
+  }
+  ASSERT(test_growth_expected_tokens, expected_tokens);
+
+  free(buffer.data);
+  stream_free(&stream);
+
+  return test_growth_no_lerr & test_growth_expected_number &
+         test_growth_expected_tokens;
+}
+
+bool test_tokenise_long_runs(void)
+{
+  const char *name = "test-long-runs";
+  stream_t stream  = {0};
+
+  // Runs of every length around the vector sizes, at every alignment,
+  // scan the same with or without SIMD
+  bool test_runs_match_scalar = true;
+  LOG_TEST_START(test_runs_match_scalar);
+  {
+    const char *fills[]      = {" \t\n\v\f\r", "a comment; 'body'",
+                                "Symbol_chars-xyz"};
+    const char terminators[] = {'x', '\n', '.'};
+    char input[160]          = {0};
+    for (size_t kind = 0; kind < ARR_SIZE(fills); ++kind)
+      for (size_t offset = 0; offset < 33; ++offset)
+        for (size_t run = 0; run < 100; ++run)
+        {
+          memset(input, '#', sizeof(input));
+          size_t fill_size = strlen(fills[kind]);
+          for (size_t i = 0; i < run; ++i)
+            input[offset + i] = fills[kind][i % fill_size];
+          input[offset + run] = terminators[kind];
+
+          const char *str = input + offset;
+          size_t n        = sizeof(input) - offset;
+          bool matches    = false;
+          if (kind == 0)
+            matches = lexer_scan_space(str, n) == run &&
+                      lexer_scan_space_scalar(str, n) == run;
+          else if (kind == 1)
+            matches = lexer_scan_comment(str, n) == run &&
+                      lexer_scan_comment_scalar(str, n) == run;
+          else
+            matches = lexer_scan_symbol(str, n) == run &&
+                      lexer_scan_symbol_scalar(str, n) == run;
+          test_runs_match_scalar &= matches;
+        }
+    printf("\t");
+    ASSERT(test_runs_all_match, test_runs_match_scalar);
+  }
+  LOG_TEST_STATUS(test_runs_match_scalar, _);
+
+  // Long runs tokenise into single tokens of the right size
+  bool test_long_tokens = true;
+  LOG_TEST_START(test_long_tokens);
+  {
+    size_t run    = 1000;
+    char *input   = calloc(run * 3 + 3, 1);
+    char *comment = input + run;
+    char *symbol  = comment + run + 1;
+    memset(input, ' ', run);
+    comment[0] = ';';
+    memset(comment + 1, '-', run - 1);
+    comment[run] = '\n';
+    memset(symbol, 'a', run);
+    buffer_t buffer = buffer_read_cstr(name, input, strlen(input));
+    lerr_t lerr     = tokenise_buffer(&stream, &buffer);
+
+    printf("\t");
+    ASSERT(test_long_no_lerr, lerr == LERR_OK);
+    printf("\t");
+    ASSERT(test_long_expected_number, stream.size == 5);
+    printf("\t");
+    ASSERT(test_long_whitespace, stream.types[0] == TOKEN_WHITESPACE &&
+                                     stream.sizes[0] == run);
+    printf("\t");
+    ASSERT(test_long_comment, stream.types[1] == TOKEN_COMMENT &&
+                                  stream.sizes[1] == run - 1);
+    printf("\t");
+    ASSERT(test_long_symbol,
+           stream.types[3] == TOKEN_SYMBOL && stream.sizes[3] == run);
+
+    test_long_tokens = test_long_no_lerr & test_long_expected_number &
+                       test_long_whitespace & test_long_comment &
+                       test_long_symbol;
+    free(input);
+    free(buffer.data);
+    stream_free(&stream);
+  }
+  LOG_TEST_STATUS(test_long_tokens, _);
+
+  return test_runs_match_scalar & test_long_tokens;
+}
+
+bool test_tokenise_streaming(void)
+{
+  const char *name = "test-streaming";
+
+  // A source a few windows long, with a comment longer than a window
+  // in the middle, streams the same tokens as tokenising it whole
+  const char *line = "label loop-start\n  push 'a' ; comment\n  dup 12.5\n";
+  size_t line_size = strlen(line), lines = 3 * LEXER_WINDOW_SIZE / line_size;
+  size_t comment_size = LEXER_WINDOW_SIZE + 100;
+  char *source        = calloc(lines * line_size + comment_size + 2, 1);
+  char *end           = source;
+  for (size_t i = 0; i < lines; ++i, end += line_size)
+  {
+    memcpy(end, line, line_size);
+    if (i == lines / 2)
+    {
+      *(end++) = ';';
+      memset(end, '-', comment_size);
+      end += comment_size;
+      *(end++) = '\n';
+    }
+  }
+
+  buffer_t buffer = buffer_read_cstr(name, source, end - source);
+  stream_t whole  = {0};
+  lerr_t lerr     = tokenise_buffer(&whole, &buffer);
+  ASSERT(test_whole_no_lerr, lerr == LERR_OK);
+
+  FILE *fp = tmpfile();
+  fwrite(source, 1, end - source, fp);
+  rewind(fp);
+  stream_t stream = {0};
+  stream_init_file(&stream, name, fp);
+
+  bool same        = true;
+  size_t capacity  = 0;
+  size_t last_line = 0, last_column = 0;
+  for (size_t i = 0; same && i < whole.size; ++i)
+  {
+    token_t expected = stream_token(&whole, i), actual = stream_pop(&stream);
+    same = actual.type == expected.type && actual.size == expected.size &&
+           memcmp(token_content(&stream, actual),
+                  token_content(&whole, expected), actual.size) == 0;
+    capacity = MAX(capacity, stream.capacity);
+    if (i == whole.size - 2)
+    {
+      // Positions carry on from bytes which have slid out of the window
+      stream_position(&whole, i, &last_line, &last_column);
+      same = same && stream_position_is(&stream, i, last_line, last_column);
+    }
+  }
+  ASSERT(test_streamed_tokens_match, same && stream_at_end(&stream) &&
+                                         stream.size == whole.size &&
+                                         stream.lerr == LERR_OK);
+  ASSERT(test_streaming_dropped_tokens,
+         !stream_position(&stream, 0, &last_line, &last_column));
+  ASSERT(test_streaming_bounded_tokens, capacity == LEXER_MIN_CAPACITY);
+  ASSERT(test_streaming_window_grows_for_long_tokens,
+         stream.window_capacity == LEXER_WINDOW_SIZE * 2);
+
+  stream_free(&stream);
+  fclose(fp);
+  stream_free(&whole);
+  free(buffer.data);
+  free(source);
+
+  // Lexer errors end the stream, recorded in it
+  fp           = tmpfile();
+  char error[] = "push 'ab'";
+  fwrite(error, 1, strlen(error), fp);
+  rewind(fp);
+  stream_init_file(&stream, name, fp);
+  while (!stream_at_end(&stream))
+    stream_pop(&stream);
+  ASSERT(test_streaming_lerr,
+         stream.lerr == LERR_CHAR_WRONG_SIZE && stream.size == 2);
+  stream_free(&stream);
+  fclose(fp);
+
+  return test_whole_no_lerr && test_streamed_tokens_match &&
+         test_streaming_dropped_tokens && test_streaming_bounded_tokens &&
+         test_streaming_window_grows_for_long_tokens && test_streaming_lerr;
+}
+
+bool test_tokenise_view(void)
+{
+  const char *name = "test-view";
+
+  // A view into the middle of a source lexes the same tokens as a copy
+  // of it, ending at the view rather than the source's terminator
+  const char *source = "push 1\n  dup 23 ; comment\nplus\n";
+  const char *view   = "  dup 23 ; comment\n";
+  buffer_t copy      = buffer_read_cstr(name, view, strlen(view));
+  buffer_t whole     = buffer_read_cstr(name, source, strlen(source));
+  buffer_t middle    = {.name      = name,
+                        .data      = whole.data + strlen("push 1\n"),
+                        .available = strlen(view)};
+
+  stream_t expected = {0}, actual = {0};
+  lerr_t lerr = tokenise_buffer(&expected, &copy);
+  lerr        = lerr == LERR_OK ? tokenise_buffer(&actual, &middle) : lerr;
+  ASSERT(test_view_no_lerr, lerr == LERR_OK);
+
+  bool same = actual.size == expected.size;
+  for (size_t i = 0; same && i < actual.size; ++i)
+    same = actual.types[i] == expected.types[i] &&
+           actual.offsets[i] == expected.offsets[i] &&
+           actual.sizes[i] == expected.sizes[i];
+  ASSERT(test_view_tokens_match, same);
+  ASSERT(test_view_ends_in_eof,
+         actual.size > 0 && actual.types[actual.size - 1] == TOKEN_EOF);
+
+  stream_free(&actual);
+  stream_free(&expected);
+  free(whole.data);
+  free(copy.data);
+  return test_view_no_lerr && test_view_tokens_match && test_view_ends_in_eof;
+}
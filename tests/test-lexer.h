@@ -9,6 +9,10 @@ bool test_tokenise_symbol(void);
 bool test_tokenise_character(void);
 bool test_tokenise_number(void);
 bool test_tokenise_comments(void);
+bool test_tokenise_growth(void);
+bool test_tokenise_long_runs(void);
+bool test_tokenise_streaming(void);
+bool test_tokenise_view(void);
 
 static const test_t TEST_LEXER_SUITE[] = {
     CREATE_TEST(test_tokenise_one_character),
@@ -17,5 +21,9 @@ static const test_t TEST_LEXER_SUITE[] = {
     CREATE_TEST(test_tokenise_character),
     CREATE_TEST(test_tokenise_number),
     CREATE_TEST(test_tokenise_comments),
+    CREATE_TEST(test_tokenise_growth),
+    CREATE_TEST(test_tokenise_long_runs),
+    CREATE_TEST(test_tokenise_streaming),
+    CREATE_TEST(test_tokenise_view),
 };
 #endif
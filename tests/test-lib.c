@@ -608,3 +608,76 @@ bool test_lib_DARR_APP(void)
          test_rand_data_uses_right_space && test_rand_data_works &&
          test_rand_data_allocated_space;
 }
+
+bool test_lib_arena(void)
+{
+  arena_t arena = {0};
+
+  // Copies are NUL terminated
+  char *first = arena_copy(&arena, "label-a", 5);
+  ASSERT(test_copy_works, strcmp(first, "label") == 0);
+
+  // Filling more than one block keeps earlier allocations in place
+  char *copies[ARENA_BLOCK_SIZE / 8] = {0};
+  for (size_t i = 0; i < ARR_SIZE(copies); ++i)
+    copies[i] = arena_copy(&arena, "0123456789abcdef", i % 16);
+  bool intact = strcmp(first, "label") == 0;
+  for (size_t i = 0; i < ARR_SIZE(copies); ++i)
+    intact = intact && strlen(copies[i]) == i % 16 &&
+             memcmp(copies[i], "0123456789abcdef", i % 16) == 0;
+  ASSERT(test_blocks_are_stable, intact && arena.head->next != NULL);
+
+  // Allocations bigger than a block get their own
+  char *big = arena_alloc(&arena, ARENA_BLOCK_SIZE * 2);
+  memset(big, 'x', ARENA_BLOCK_SIZE * 2);
+  ASSERT(test_oversized_allocation, arena.head->size >= ARENA_BLOCK_SIZE * 2);
+
+  arena_free(&arena);
+  ASSERT(test_free_resets, arena.head == NULL);
+
+  return test_copy_works && test_blocks_are_stable &&
+         test_oversized_allocation && test_free_resets;
+}
+
+bool test_lib_htab(void)
+{
+  htab_t htab = {0};
+  htab_init(&htab, 0);
+
+  // Keys are views: only the given size of them is the key
+  const char *names = "label-a label-b";
+  ASSERT(test_insert_new, htab_insert(&htab, names, 7, 1) &&
+                              htab_insert(&htab, names + 8, 7, 2));
+  ASSERT(test_insert_duplicate, !htab_insert(&htab, "label-a", 7, 3));
+
+  word value = 0;
+  ASSERT(test_get_present,
+         htab_get(&htab, "label-a", 7, &value) && value == 1 &&
+             htab_get(&htab, "label-b", 7, &value) && value == 2);
+  ASSERT(test_get_absent, !htab_get(&htab, "label", 5, &value) &&
+                              !htab_get(&htab, "label-c", 7, &value));
+
+  // Keys are interned, so the memory they came from may change
+  char key[32] = {0};
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    int size = snprintf(key, sizeof(key), "key-%lu", i);
+    htab_insert(&htab, key, size, i);
+  }
+  memset(key, 0, sizeof(key));
+  bool all_present = htab.used == 1002;
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    int size    = snprintf(key, sizeof(key), "key-%lu", i);
+    all_present = all_present && htab_get(&htab, key, size, &value) &&
+                  value == i;
+  }
+  ASSERT(test_growth_keeps_entries,
+         all_present && htab.used * 4 <= htab.capacity * 3);
+
+  htab_free(&htab);
+  ASSERT(test_free_resets, htab.entries == NULL && htab.capacity == 0);
+
+  return test_insert_new && test_insert_duplicate && test_get_present &&
+         test_get_absent && test_growth_keeps_entries && test_free_resets;
+}
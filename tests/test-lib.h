@@ -21,6 +21,9 @@ bool test_lib_darr_mem_append(void);
 bool test_lib_darr_mem_insert(void);
 bool test_lib_DARR_APP(void);
 
+bool test_lib_arena(void);
+bool test_lib_htab(void);
+
 static const test_t TEST_LIB_SUITE[] = {
     CREATE_TEST(test_lib_MAX),
     CREATE_TEST(test_lib_MIN),
@@ -37,6 +40,8 @@ static const test_t TEST_LIB_SUITE[] = {
     CREATE_TEST(test_lib_darr_mem_append),
     CREATE_TEST(test_lib_darr_mem_insert),
     CREATE_TEST(test_lib_DARR_APP),
+    CREATE_TEST(test_lib_arena),
+    CREATE_TEST(test_lib_htab),
 };
 
 #endif
@@ -0,0 +1,449 @@
+/* test-optimiser.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Unit tests for optimiser.h
+ */
+
+#include "./test-optimiser.h"
+#include "./test.h"
+
+#include "../src/optimiser.h"
+#include "../src/vm.h"
+
+#include <string.h>
+
+#define JMP(N)  OP_CREATE_JMP(data_uint(N))
+#define PUSH(N) OP_CREATE_PUSH(data_int(N))
+#define ADDR(N) OP_CREATE_PUSH(data_uint(N))
+
+// A finished emitter holding program, with relocations at the given
+// addresses
+void optimiser_emitter(emitter_t *emitter, const op_t *program, size_t size,
+                       const size_t *relocations, size_t size_relocations)
+{
+  emitter_init(emitter);
+  for (size_t i = 0; i < size; ++i)
+    DARR_APP(&emitter->program, op_t, program[i]);
+  for (size_t i = 0; i < size_relocations; ++i)
+    DARR_APP(&emitter->relocations, size_t, relocations[i]);
+}
+
+// Whether the emitter's program is exactly expected
+bool optimiser_program_is(emitter_t *emitter, const op_t *expected,
+                          size_t size)
+{
+  if (emitter->program.used != size)
+    return false;
+  for (size_t i = 0; i < size; ++i)
+  {
+    op_t op = DARR_MEMBER(&emitter->program, op_t, i);
+    if (op.opcode != expected[i].opcode || op.operand != expected[i].operand)
+      return false;
+  }
+  return true;
+}
+
+// Whether the emitter's relocations are exactly expected
+bool optimiser_relocations_are(emitter_t *emitter, const size_t *expected,
+                               size_t size)
+{
+  return emitter->relocations.used == size &&
+         (size == 0 ||
+          memcmp(emitter->relocations.data, expected,
+                 size * sizeof(*expected)) == 0);
+}
+
+bool test_optimiser_address(void)
+{
+  size_t address = 0;
+  ASSERT(test_address_jump,
+         optimiser_address(JMP(3), false, 4, &address) && address == 3);
+  // Jumping to the end of the program is legal
+  ASSERT(test_address_end,
+         optimiser_address(JMP(4), false, 4, &address) && address == 4);
+  ASSERT(test_address_outside, !optimiser_address(JMP(5), false, 4, &address));
+  ASSERT(test_address_dynamic,
+         !optimiser_address(OP_CREATE_JMP(data_nil()), false, 4, &address));
+  // Only relocated pushes hold addresses, not uint literals
+  ASSERT(test_address_push,
+         optimiser_address(ADDR(2), true, 4, &address) && address == 2 &&
+             !optimiser_address(ADDR(2), false, 4, &address));
+  return test_address_jump && test_address_end && test_address_outside &&
+         test_address_dynamic && test_address_push;
+}
+
+bool test_optimiser_peephole_pairs(void)
+{
+  // 0: push 1, 1: pop, 2: push 2, 3: dup 0, 4: pop, 5: noop, 6: jmp 7,
+  // 7: print, 8: halt
+  op_t program[]  = {PUSH(1),
+                     OP_CREATE_POP,
+                     PUSH(2),
+                     OP_CREATE_DUP(data_uint(0)),
+                     OP_CREATE_POP,
+                     OP_CREATE_NOOP,
+                     JMP(7),
+                     OP_CREATE_PRINT,
+                     OP_CREATE_HALT};
+  op_t expected[] = {PUSH(2), OP_CREATE_PRINT, OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_peephole(&emitter);
+  ASSERT(test_pairs_removed, removed == 6);
+  ASSERT(test_pairs_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+
+  emitter_free(&emitter);
+  return test_pairs_removed && test_pairs_program;
+}
+
+bool test_optimiser_peephole_target(void)
+{
+  // 0: jmp 2, 1: push 1, 2: pop, 3: halt, where the pop is a target so
+  // the pair stays
+  op_t program[] = {JMP(2), PUSH(1), OP_CREATE_POP, OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_peephole(&emitter);
+  ASSERT(test_target_removed, removed == 0);
+  ASSERT(test_target_program,
+         optimiser_program_is(&emitter, program, ARR_SIZE(program)));
+
+  emitter_free(&emitter);
+  return test_target_removed && test_target_program;
+}
+
+bool test_optimiser_peephole_nested(void)
+{
+  // push a; push b; pop; pop
+  op_t program[]  = {PUSH(1), PUSH(2), OP_CREATE_POP, OP_CREATE_POP,
+                     OP_CREATE_HALT};
+  op_t expected[] = {OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_peephole(&emitter);
+  ASSERT(test_nested_removed, removed == 4);
+  ASSERT(test_nested_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+
+  emitter_free(&emitter);
+  return test_nested_removed && test_nested_program;
+}
+
+bool test_optimiser_peephole_remap(void)
+{
+  // 0: push *3, 1: jmp 4, 2: halt, 3: noop, 4: push 1, 5: pop,
+  // 6: print, 7: jmp *, with a label on the pop
+  op_t program[]        = {ADDR(3),        JMP(4),
+                           OP_CREATE_HALT, OP_CREATE_NOOP,
+                           PUSH(1),        OP_CREATE_POP,
+                           OP_CREATE_PRINT, OP_CREATE_JMP(data_nil())};
+  size_t relocations[]  = {0, 1};
+  // Everything pointing into 3..5 now points at the print
+  op_t expected[]       = {ADDR(3), JMP(3), OP_CREATE_HALT, OP_CREATE_PRINT,
+                           OP_CREATE_JMP(data_nil())};
+  emitter_t emitter     = {0};
+  word label            = 0;
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), relocations,
+                    ARR_SIZE(relocations));
+  htab_insert(&emitter.labels, "pop", 3, 5);
+
+  size_t removed = optimiser_peephole(&emitter);
+  ASSERT(test_remap_removed, removed == 3);
+  ASSERT(test_remap_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+  ASSERT(test_remap_relocations,
+         optimiser_relocations_are(&emitter, relocations,
+                                   ARR_SIZE(relocations)));
+  ASSERT(test_remap_label,
+         htab_get(&emitter.labels, "pop", 3, &label) && label == 3);
+
+  emitter_free(&emitter);
+  return test_remap_removed && test_remap_program && test_remap_relocations &&
+         test_remap_label;
+}
+
+bool test_optimiser_fold_chain(void)
+{
+  // push 3; push 4; mult; push 2; plus
+  op_t program[]    = {PUSH(3), PUSH(4), OP_CREATE_MULT, PUSH(2),
+                       OP_CREATE_PLUS, OP_CREATE_HALT};
+  op_t expected[]   = {PUSH(14), OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_fold(&emitter);
+  ASSERT(test_chain_removed, removed == 4);
+  ASSERT(test_chain_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+
+  emitter_free(&emitter);
+  return test_chain_removed && test_chain_program;
+}
+
+bool test_optimiser_fold_overflow(void)
+{
+  op_t program[]    = {PUSH(INT60_MAX), PUSH(1), OP_CREATE_PLUS,
+                       OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  vm_t vm           = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_fold(&emitter);
+  ASSERT(test_overflow_removed, removed == 0);
+  ASSERT(test_overflow_program,
+         optimiser_program_is(&emitter, program, ARR_SIZE(program)));
+  // So the error happens when it's run
+  vm_copy_program(&vm, emitter.program.data, emitter.program.used);
+  ASSERT(test_overflow_runtime, vm_execute_all(&vm) == ERR_INTEGER_OVERFLOW);
+
+  vm_free(&vm);
+  emitter_free(&emitter);
+  return test_overflow_removed && test_overflow_program &&
+         test_overflow_runtime;
+}
+
+bool test_optimiser_fold_float(void)
+{
+  op_t program[]    = {OP_CREATE_PUSH(data_float(1.5)), PUSH(2),
+                       OP_CREATE_PLUS, OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_fold(&emitter);
+  ASSERT(test_float_removed, removed == 0);
+  ASSERT(test_float_program,
+         optimiser_program_is(&emitter, program, ARR_SIZE(program)));
+
+  emitter_free(&emitter);
+  return test_float_removed && test_float_program;
+}
+
+bool test_optimiser_fold_target(void)
+{
+  // 0: push 1, 1: push 2, 2: plus, 3: halt, 4: jmp 1, where jumping to
+  // the second push skips the first
+  op_t program[]    = {PUSH(1), PUSH(2), OP_CREATE_PLUS, OP_CREATE_HALT,
+                       JMP(1)};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_fold(&emitter);
+  ASSERT(test_target_removed, removed == 0);
+  ASSERT(test_target_program,
+         optimiser_program_is(&emitter, program, ARR_SIZE(program)));
+
+  emitter_free(&emitter);
+  return test_target_removed && test_target_program;
+}
+
+bool test_optimiser_fold_retarget(void)
+{
+  // 0: jmp 2, 1: halt, 2: push 3, 3: push 4, 4: plus, 5: print,
+  // 6: halt
+  op_t program[]    = {JMP(2),         OP_CREATE_HALT,  PUSH(3), PUSH(4),
+                       OP_CREATE_PLUS, OP_CREATE_PRINT, OP_CREATE_HALT};
+  op_t expected[]   = {JMP(2), OP_CREATE_HALT, PUSH(7), OP_CREATE_PRINT,
+                       OP_CREATE_HALT};
+  size_t relocations[] = {0};
+  emitter_t emitter    = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), relocations,
+                    ARR_SIZE(relocations));
+
+  size_t removed = optimiser_fold(&emitter);
+  ASSERT(test_retarget_removed, removed == 2);
+  // The jump lands on the folded push
+  ASSERT(test_retarget_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+  ASSERT(test_retarget_relocations,
+         optimiser_relocations_are(&emitter, relocations,
+                                   ARR_SIZE(relocations)));
+
+  emitter_free(&emitter);
+  return test_retarget_removed && test_retarget_program &&
+         test_retarget_relocations;
+}
+
+bool test_optimiser_fold_dup(void)
+{
+  // push 5; dup 0; mult
+  op_t program[]    = {PUSH(5), OP_CREATE_DUP(data_uint(0)), OP_CREATE_MULT,
+                       OP_CREATE_HALT};
+  op_t expected[]   = {PUSH(25), OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_fold(&emitter);
+  ASSERT(test_dup_removed, removed == 2);
+  ASSERT(test_dup_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+
+  emitter_free(&emitter);
+  return test_dup_removed && test_dup_program;
+}
+
+bool test_optimiser_thread_chain(void)
+{
+  // 0: jmp 2, 1: halt, 2: jmp 4, 3: halt, 4: print, 5: halt
+  op_t program[]    = {JMP(2),         OP_CREATE_HALT,  JMP(4),
+                       OP_CREATE_HALT, OP_CREATE_PRINT, OP_CREATE_HALT};
+  op_t expected[]   = {JMP(4),         OP_CREATE_HALT,  JMP(4),
+                       OP_CREATE_HALT, OP_CREATE_PRINT, OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t threaded = optimiser_thread(&emitter);
+  ASSERT(test_chain_threaded, threaded == 1);
+  ASSERT(test_chain_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+
+  emitter_free(&emitter);
+  return test_chain_threaded && test_chain_program;
+}
+
+bool test_optimiser_thread_cycle(void)
+{
+  // 0: jmp 1, 1: jmp 2, 2: jmp 1, a chain ending in a cycle
+  op_t program[]    = {JMP(1), JMP(2), JMP(1)};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t threaded = optimiser_thread(&emitter);
+  ASSERT(test_cycle_threaded, threaded == 0);
+  ASSERT(test_cycle_program,
+         optimiser_program_is(&emitter, program, ARR_SIZE(program)));
+
+  emitter_free(&emitter);
+  return test_cycle_threaded && test_cycle_program;
+}
+
+bool test_optimiser_unreachable_return_site(void)
+{
+  // 0: push *3, 1: jmp 4, 2: print, 3: halt, 4: jmp *, where the halt is
+  // only reached by returning to it
+  op_t program[]       = {ADDR(3), JMP(4), OP_CREATE_PRINT, OP_CREATE_HALT,
+                          OP_CREATE_JMP(data_nil())};
+  size_t relocations[] = {0, 1};
+  op_t expected[]      = {ADDR(2), JMP(3), OP_CREATE_HALT,
+                          OP_CREATE_JMP(data_nil())};
+  emitter_t emitter    = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), relocations,
+                    ARR_SIZE(relocations));
+
+  size_t removed = optimiser_unreachable(&emitter);
+  ASSERT(test_return_site_removed, removed == 1);
+  ASSERT(test_return_site_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+  ASSERT(test_return_site_relocations,
+         optimiser_relocations_are(&emitter, relocations,
+                                   ARR_SIZE(relocations)));
+
+  emitter_free(&emitter);
+  return test_return_site_removed && test_return_site_program &&
+         test_return_site_relocations;
+}
+
+bool test_optimiser_unreachable_halt(void)
+{
+  op_t program[]    = {OP_CREATE_PRINT, OP_CREATE_HALT, OP_CREATE_PRINT,
+                       PUSH(1)};
+  op_t expected[]   = {OP_CREATE_PRINT, OP_CREATE_HALT};
+  emitter_t emitter = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), NULL, 0);
+
+  size_t removed = optimiser_unreachable(&emitter);
+  ASSERT(test_halt_removed, removed == 2);
+  ASSERT(test_halt_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+
+  emitter_free(&emitter);
+  return test_halt_removed && test_halt_program;
+}
+
+bool test_optimiser_layout_hot(void)
+{
+  // 0: noop, 1: jmp 5 | 2: push 'x', 3: print, 4: halt | 5: push 1 |
+  // 6: print, 7: halt | 8: jmp 6, where only the blocks at 0, 5 and 6
+  // ran and the cold blocks lie between them
+  op_t program[]       = {OP_CREATE_NOOP,
+                          JMP(5),
+                          OP_CREATE_PUSH(data_char('x')),
+                          OP_CREATE_PRINT,
+                          OP_CREATE_HALT,
+                          PUSH(1),
+                          OP_CREATE_PRINT,
+                          OP_CREATE_HALT,
+                          JMP(6)};
+  size_t relocations[] = {1, 8};
+  u64 block_counts[]   = {1, 0, 0, 0, 0, 1, 1, 0, 0};
+  u64 jump_counts[]    = {0, 1, 0, 0, 0, 0, 0, 0, 0};
+  // The entry block first, the jump to 5 deleted as it now falls
+  // through, 5 falling through to 6 and the cold blocks last
+  op_t expected[]               = {OP_CREATE_NOOP,
+                                   PUSH(1),
+                                   OP_CREATE_PRINT,
+                                   OP_CREATE_HALT,
+                                   OP_CREATE_PUSH(data_char('x')),
+                                   OP_CREATE_PRINT,
+                                   OP_CREATE_HALT,
+                                   JMP(2)};
+  size_t expected_relocations[] = {7};
+  emitter_t emitter             = {0};
+  optimiser_layout_t stats      = {0};
+  word label                    = 0;
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), relocations,
+                    ARR_SIZE(relocations));
+  htab_insert(&emitter.labels, "cold", 4, 2);
+
+  optimiser_layout(&emitter, block_counts, jump_counts, &stats);
+  ASSERT(test_hot_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+  ASSERT(test_hot_relocations,
+         optimiser_relocations_are(&emitter, expected_relocations,
+                                   ARR_SIZE(expected_relocations)));
+  ASSERT(test_hot_label,
+         htab_get(&emitter.labels, "cold", 4, &label) && label == 4);
+  ASSERT(test_hot_stats, stats.deleted == 1 && stats.inserted == 0 &&
+                             stats.cold == 2 && stats.taken_before == 1 &&
+                             stats.taken_after == 0);
+
+  emitter_free(&emitter);
+  return test_hot_program && test_hot_relocations && test_hot_label &&
+         test_hot_stats;
+}
+
+bool test_optimiser_layout_inserted(void)
+{
+  // 0: jmp 3 | 1: push 'x', 2: print | 3: print, 4: halt, where the
+  // cold block at 1 fell through to 3 but the entry's jump is hotter
+  op_t program[]       = {JMP(3), OP_CREATE_PUSH(data_char('x')),
+                          OP_CREATE_PRINT, OP_CREATE_PRINT, OP_CREATE_HALT};
+  size_t relocations[] = {0};
+  u64 block_counts[]   = {1, 0, 0, 1, 0};
+  u64 jump_counts[]    = {1, 0, 0, 0, 0};
+  // The cold block moves to the end and jumps back
+  op_t expected[]               = {OP_CREATE_PRINT, OP_CREATE_HALT,
+                                   OP_CREATE_PUSH(data_char('x')),
+                                   OP_CREATE_PRINT, JMP(0)};
+  size_t expected_relocations[] = {4};
+  emitter_t emitter             = {0};
+  optimiser_layout_t stats      = {0};
+  optimiser_emitter(&emitter, program, ARR_SIZE(program), relocations,
+                    ARR_SIZE(relocations));
+
+  optimiser_layout(&emitter, block_counts, jump_counts, &stats);
+  ASSERT(test_inserted_program,
+         optimiser_program_is(&emitter, expected, ARR_SIZE(expected)));
+  ASSERT(test_inserted_relocations,
+         optimiser_relocations_are(&emitter, expected_relocations,
+                                   ARR_SIZE(expected_relocations)));
+  ASSERT(test_inserted_stats, stats.deleted == 1 && stats.inserted == 1 &&
+                                  stats.cold == 1 && stats.taken_after == 0);
+
+  emitter_free(&emitter);
+  return test_inserted_program && test_inserted_relocations &&
+         test_inserted_stats;
+}
@@ -0,0 +1,44 @@
+#ifndef TEST_OPTIMISER_H
+#define TEST_OPTIMISER_H
+
+#include "./test.h"
+
+bool test_optimiser_address(void);
+bool test_optimiser_peephole_pairs(void);
+bool test_optimiser_peephole_target(void);
+bool test_optimiser_peephole_nested(void);
+bool test_optimiser_peephole_remap(void);
+bool test_optimiser_fold_chain(void);
+bool test_optimiser_fold_overflow(void);
+bool test_optimiser_fold_float(void);
+bool test_optimiser_fold_target(void);
+bool test_optimiser_fold_retarget(void);
+bool test_optimiser_fold_dup(void);
+bool test_optimiser_thread_chain(void);
+bool test_optimiser_thread_cycle(void);
+bool test_optimiser_unreachable_return_site(void);
+bool test_optimiser_unreachable_halt(void);
+bool test_optimiser_layout_hot(void);
+bool test_optimiser_layout_inserted(void);
+
+static const test_t TEST_OPTIMISER_SUITE[] = {
+    CREATE_TEST(test_optimiser_address),
+    CREATE_TEST(test_optimiser_peephole_pairs),
+    CREATE_TEST(test_optimiser_peephole_target),
+    CREATE_TEST(test_optimiser_peephole_nested),
+    CREATE_TEST(test_optimiser_peephole_remap),
+    CREATE_TEST(test_optimiser_fold_chain),
+    CREATE_TEST(test_optimiser_fold_overflow),
+    CREATE_TEST(test_optimiser_fold_float),
+    CREATE_TEST(test_optimiser_fold_target),
+    CREATE_TEST(test_optimiser_fold_retarget),
+    CREATE_TEST(test_optimiser_fold_dup),
+    CREATE_TEST(test_optimiser_thread_chain),
+    CREATE_TEST(test_optimiser_thread_cycle),
+    CREATE_TEST(test_optimiser_unreachable_return_site),
+    CREATE_TEST(test_optimiser_unreachable_halt),
+    CREATE_TEST(test_optimiser_layout_hot),
+    CREATE_TEST(test_optimiser_layout_inserted),
+};
+
+#endif
@@ -0,0 +1,331 @@
+/* test-parser.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Unit tests for parser.h
+ */
+
+#include "./test-parser.h"
+#include "./test.h"
+
+#include "../src/object.h"
+#include "../src/parser.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PARSER_MOCK_FILE "tests/TEST_PARSER_MOCK_FILE.txt"
+
+// Lex source into stream (keeping its text in buffer) then parse every
+// line of it into a fresh emitter, leaving the fixups unresolved
+perr_t parser_emit_cstr(const char *source, buffer_t *buffer,
+                        stream_t *stream, emitter_t *emitter)
+{
+  *buffer = buffer_read_cstr("*test-parser*", source, strlen(source));
+  *stream = (stream_t){0};
+  emitter_init(emitter);
+  if (tokenise_buffer(stream, buffer) != LERR_OK)
+    return PERR_EOF;
+  return parse_emit(stream, emitter);
+}
+
+void parser_free(buffer_t *buffer, stream_t *stream, emitter_t *emitter)
+{
+  emitter_free(emitter);
+  stream_free(stream);
+  free(buffer->data);
+}
+
+// Whether the token at the stream's cursor is text, on line
+bool parser_cursor_at(stream_t *stream, const char *text, size_t line)
+{
+  size_t cursor_line = 0, column = 0;
+  return stream_position(stream, stream->cursor, &cursor_line, &column) &&
+         cursor_line == line &&
+         token_equals(stream, stream_token(stream, stream->cursor), text);
+}
+
+bool test_parser_labels(void)
+{
+  buffer_t buffer   = {0};
+  stream_t stream   = {0};
+  emitter_t emitter = {0};
+  perr_t perr = parser_emit_cstr("label start\n"
+                                 "  jmp end\n"
+                                 "  noop\n"
+                                 "label end\n"
+                                 "  jmp start\n",
+                                 &buffer, &stream, &emitter);
+  op_t *program = emitter.program.data;
+
+  // Labels emit nothing, and only the jump to end waits for a fixup
+  ASSERT(test_labels_parsed, perr == PERR_OK && emitter.program.used == 3);
+  ASSERT(test_labels_backward,
+         program[2].opcode == OP_JUMP && program[2].operand == data_uint(0));
+  ASSERT(test_labels_fixup, emitter.fixups.used == 1 &&
+                                DARR_MEMBER(&emitter.fixups, fixup_t, 0)
+                                        .address == 0);
+  ASSERT(test_labels_forward,
+         emitter_finish(&emitter, &stream) == PERR_OK &&
+             emitter.fixups.used == 0 && program[0].opcode == OP_JUMP &&
+             program[0].operand == data_uint(2));
+  ASSERT(test_labels_relocations,
+         emitter.relocations.used == 2 &&
+             DARR_MEMBER(&emitter.relocations, size_t, 0) == 0 &&
+             DARR_MEMBER(&emitter.relocations, size_t, 1) == 2);
+
+  parser_free(&buffer, &stream, &emitter);
+  return test_labels_parsed && test_labels_backward && test_labels_fixup &&
+         test_labels_forward && test_labels_relocations;
+}
+
+bool test_parser_unknown_label(void)
+{
+  buffer_t buffer   = {0};
+  stream_t stream   = {0};
+  emitter_t emitter = {0};
+  perr_t perr = parser_emit_cstr("  noop\n"
+                                 "  jmp nowhere\n"
+                                 "  noop\n",
+                                 &buffer, &stream, &emitter);
+
+  ASSERT(test_unknown_parsed, perr == PERR_OK);
+  ASSERT(test_unknown_left, emitter_resolve(&emitter) == 1);
+  // The error points at the jump, not wherever parsing stopped
+  ASSERT(test_unknown_error,
+         emitter_finish(&emitter, &stream) == PERR_UNKNOWN_LABEL &&
+             parser_cursor_at(&stream, "jmp", 2));
+
+  parser_free(&buffer, &stream, &emitter);
+  return test_unknown_parsed && test_unknown_left && test_unknown_error;
+}
+
+bool test_parser_duplicate_label(void)
+{
+  buffer_t buffer   = {0};
+  stream_t stream   = {0};
+  emitter_t emitter = {0};
+  perr_t perr = parser_emit_cstr("label a\n"
+                                 "  noop\n"
+                                 "label a\n"
+                                 "  noop\n",
+                                 &buffer, &stream, &emitter);
+
+  ASSERT(test_duplicate_error, perr == PERR_DUPLICATE_LABEL);
+  ASSERT(test_duplicate_cursor, parser_cursor_at(&stream, "label", 3));
+  // The first definition is kept
+  word address = 1;
+  ASSERT(test_duplicate_first,
+         htab_get(&emitter.labels, "a", 1, &address) && address == 0);
+
+  parser_free(&buffer, &stream, &emitter);
+  return test_duplicate_error && test_duplicate_cursor && test_duplicate_first;
+}
+
+bool test_parser_iptr(void)
+{
+  buffer_t buffer   = {0};
+  stream_t stream   = {0};
+  emitter_t emitter = {0};
+  perr_t perr = parser_emit_cstr("  noop\n"
+                                 "  push *\n"
+                                 "  push *2\n"
+                                 "  push 2\n",
+                                 &buffer, &stream, &emitter);
+  op_t *program = emitter.program.data;
+
+  // Addresses of the next instruction plus N, as uints
+  ASSERT(test_iptr_parsed, perr == PERR_OK && emitter.program.used == 4);
+  ASSERT(test_iptr_next, program[1].opcode == OP_PUSH &&
+                             program[1].operand == data_uint(2));
+  ASSERT(test_iptr_offset, program[2].operand == data_uint(5));
+  // Only the pushes of addresses are relocated, not the literal
+  ASSERT(test_iptr_relocations,
+         emitter.relocations.used == 2 &&
+             DARR_MEMBER(&emitter.relocations, size_t, 0) == 1 &&
+             DARR_MEMBER(&emitter.relocations, size_t, 1) == 2 &&
+             program[3].operand == data_int(2));
+
+  parser_free(&buffer, &stream, &emitter);
+  return test_iptr_parsed && test_iptr_next && test_iptr_offset &&
+         test_iptr_relocations;
+}
+
+// Write emitter as an object then read it back into copy, changing
+// the byte at offset into the object to patch first if it isn't NULL
+bool parser_object_copy(emitter_t *emitter, emitter_t *copy, size_t offset,
+                        const byte *patch)
+{
+  FILE *fp = fopen(PARSER_MOCK_FILE, "wb");
+  object_write(emitter, fp);
+  fclose(fp);
+  if (patch)
+  {
+    fp = fopen(PARSER_MOCK_FILE, "r+b");
+    fseek(fp, offset, SEEK_SET);
+    fwrite(patch, 1, 1, fp);
+    fclose(fp);
+  }
+
+  fp              = fopen(PARSER_MOCK_FILE, "rb");
+  buffer_t buffer = buffer_read_file(PARSER_MOCK_FILE, fp);
+  fclose(fp);
+  remove(PARSER_MOCK_FILE);
+  bool ok = object_read(copy, &buffer);
+  free(buffer.data);
+  return ok;
+}
+
+bool test_parser_objects(void)
+{
+  buffer_t buffers[2]   = {0};
+  stream_t streams[2]   = {0};
+  emitter_t emitters[2] = {0}, objects[2] = {0};
+  perr_t perr_first = parser_emit_cstr("  push *\n"
+                                       "  jmp far\n"
+                                       "label near\n"
+                                       "  halt\n",
+                                       buffers, streams, emitters);
+  perr_t perr_second =
+      parser_emit_cstr("label far\n"
+                       "  jmp near\n",
+                       buffers + 1, streams + 1, emitters + 1);
+  ASSERT(test_objects_parsed, perr_first == PERR_OK &&
+                                  perr_second == PERR_OK &&
+                                  emitter_resolve(emitters) == 1 &&
+                                  emitter_resolve(emitters + 1) == 1);
+
+  // Each jumps to a label of the other, so only linking resolves them
+  ASSERT(test_objects_read, parser_object_copy(emitters, objects, 0, NULL) &&
+                                parser_object_copy(emitters + 1, objects + 1,
+                                                   0, NULL));
+  darr_t program = {0};
+  ASSERT(test_objects_linked,
+         test_objects_read &&
+             emitter_link(objects, ARR_SIZE(objects), &program, NULL) ==
+                 PERR_OK);
+  op_t *ops = program.data;
+  ASSERT(test_objects_program,
+         test_objects_linked && program.used == 4 &&
+             ops[0].opcode == OP_PUSH && ops[0].operand == data_uint(1) &&
+             ops[1].opcode == OP_JUMP && ops[1].operand == data_uint(3) &&
+             ops[2].opcode == OP_HALT && ops[3].opcode == OP_JUMP &&
+             ops[3].operand == data_uint(2));
+
+  // The first instruction's opcode then the low byte of its operand,
+  // after the object's magic, version and the number of instructions
+  const size_t op_offset = sizeof(OBJECT_MAGIC) - 1 + 2 * sizeof(word);
+  emitter_t bad = {0};
+  // print takes no operand
+  const byte print = OP_PRINT;
+  ASSERT(test_objects_wrong_type,
+         !parser_object_copy(emitters, &bad, op_offset, &print));
+  // 1 isn't a tag of any type
+  const byte untagged = 1;
+  ASSERT(test_objects_untagged,
+         !parser_object_copy(emitters, &bad, op_offset + 1, &untagged));
+
+  if (test_objects_linked)
+    darr_free(&program);
+  for (size_t i = 0; i < ARR_SIZE(objects); ++i)
+  {
+    if (test_objects_read)
+      emitter_free(objects + i);
+    parser_free(buffers + i, streams + i, emitters + i);
+  }
+  return test_objects_parsed && test_objects_read && test_objects_linked &&
+         test_objects_program && test_objects_wrong_type &&
+         test_objects_untagged;
+}
+
+// The mnemonic source (a single symbol) is, or NULL
+const mnemonic_t *parser_mnemonic_cstr(const char *source)
+{
+  buffer_t buffer            = buffer_read_cstr("*test-parser*", source,
+                                                strlen(source));
+  stream_t stream            = {0};
+  const mnemonic_t *mnemonic = NULL;
+  if (tokenise_buffer(&stream, &buffer) == LERR_OK && stream.size > 0 &&
+      stream_token(&stream, 0).type == TOKEN_SYMBOL &&
+      stream_token(&stream, 0).size == strlen(source))
+    mnemonic = parser_mnemonic(&stream, stream_token(&stream, 0));
+  stream_free(&stream);
+  free(buffer.data);
+  return mnemonic;
+}
+
+static const struct
+{
+  const char *name;
+  inst_t opcode;
+  bool operand;
+} PARSER_MOCK_MNEMONICS[] = {
+    {"noop", OP_NONE, false}, {"halt", OP_HALT, false},
+    {"push", OP_PUSH, true},  {"pop", OP_POP, false},
+    {"plus", OP_PLUS, false}, {"mult", OP_MULT, false},
+    {"dup", OP_DUP, true},    {"print", OP_PRINT, false},
+    {"label", OP_NONE, true}, {"jmp", OP_JUMP, true},
+};
+
+bool test_parser_mnemonics(void)
+{
+  bool found = true;
+  for (size_t i = 0; i < ARR_SIZE(PARSER_MOCK_MNEMONICS); ++i)
+  {
+    const mnemonic_t *mnemonic =
+        parser_mnemonic_cstr(PARSER_MOCK_MNEMONICS[i].name);
+    found = found && mnemonic &&
+            strcmp(mnemonic->name, PARSER_MOCK_MNEMONICS[i].name) == 0 &&
+            mnemonic->opcode == PARSER_MOCK_MNEMONICS[i].opcode &&
+            (mnemonic->parse != NULL) == PARSER_MOCK_MNEMONICS[i].operand;
+  }
+  ASSERT(test_mnemonics_found, found);
+
+  // Symbols in the slot of each mnemonic (same size and first two
+  // characters) which differ in their last character
+  bool near_misses = true;
+  for (size_t i = 0; i < ARR_SIZE(PARSER_MOCK_MNEMONICS); ++i)
+  {
+    char name[8] = {0};
+    size_t size  = strlen(PARSER_MOCK_MNEMONICS[i].name);
+    memcpy(name, PARSER_MOCK_MNEMONICS[i].name, size);
+    // Every mnemonic has at least 3 characters, so this keeps its slot
+    name[size - 1] = 'x';
+    near_misses    = near_misses && !parser_mnemonic_cstr(name);
+  }
+  ASSERT(test_mnemonics_near_misses, near_misses);
+  // Prefixes and extensions of a mnemonic, and a single character
+  ASSERT(test_mnemonics_sizes, !parser_mnemonic_cstr("pus") &&
+                                   !parser_mnemonic_cstr("pushx") &&
+                                   !parser_mnemonic_cstr("p"));
+
+  return test_mnemonics_found && test_mnemonics_near_misses &&
+         test_mnemonics_sizes;
+}
+
+bool test_parser_unexpected_operand(void)
+{
+  buffer_t buffer   = {0};
+  stream_t stream   = {0};
+  emitter_t emitter = {0};
+
+  // A comment after a mnemonic without an operand is fine
+  perr_t perr = parser_emit_cstr("  halt ; done\n", &buffer, &stream,
+                                 &emitter);
+  ASSERT(test_unexpected_comment, perr == PERR_OK);
+  parser_free(&buffer, &stream, &emitter);
+
+  // An operand right after the mnemonic
+  perr = parser_emit_cstr("  print\n  halt*\n", &buffer, &stream, &emitter);
+  ASSERT(test_unexpected_operand, perr == PERR_UNEXPECTED_OPERAND &&
+                                      parser_cursor_at(&stream, "*", 2));
+  parser_free(&buffer, &stream, &emitter);
+
+  // One after some whitespace is taken as the next instruction
+  perr = parser_emit_cstr("  halt 1\n", &buffer, &stream, &emitter);
+  ASSERT(test_unexpected_next, perr == PERR_ILLEGAL_OPERATOR &&
+                                   parser_cursor_at(&stream, "1", 1));
+  parser_free(&buffer, &stream, &emitter);
+
+  return test_unexpected_comment && test_unexpected_operand &&
+         test_unexpected_next;
+}
@@ -0,0 +1,24 @@
+#ifndef TEST_PARSER_H
+#define TEST_PARSER_H
+
+#include "./test.h"
+
+bool test_parser_labels(void);
+bool test_parser_unknown_label(void);
+bool test_parser_duplicate_label(void);
+bool test_parser_iptr(void);
+bool test_parser_objects(void);
+bool test_parser_mnemonics(void);
+bool test_parser_unexpected_operand(void);
+
+static const test_t TEST_PARSER_SUITE[] = {
+    CREATE_TEST(test_parser_labels),
+    CREATE_TEST(test_parser_unknown_label),
+    CREATE_TEST(test_parser_duplicate_label),
+    CREATE_TEST(test_parser_iptr),
+    CREATE_TEST(test_parser_objects),
+    CREATE_TEST(test_parser_mnemonics),
+    CREATE_TEST(test_parser_unexpected_operand),
+};
+
+#endif
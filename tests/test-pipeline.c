@@ -0,0 +1,150 @@
+/* test-pipeline.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Unit tests for pipeline.h
+ */
+
+#include "./test-pipeline.h"
+#include "./test.h"
+
+#include "../src/pipeline.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Enough lines that every ring fills and wraps around a few times
+#define PIPELINE_MOCK_LINES (PIPELINE_BATCH * PIPELINE_SLOTS)
+// Symbols can't have digits, so labels are numbered in letters
+#define PIPELINE_MOCK_LABEL(N) (char)('a' + (N) / 26), (char)('a' + (N) % 26)
+
+// A source of loops jumping back and forward, with line (if not NULL)
+// in place of the middle one
+buffer_t pipeline_mock_source(const char *line)
+{
+  darr_t text = {0};
+  darr_init(&text, DARR_INITAL_SIZE, 1);
+  char buf[64];
+  for (size_t i = 0; i < PIPELINE_MOCK_LINES; ++i)
+  {
+    int size = 0;
+    if (line && i == PIPELINE_MOCK_LINES / 2)
+      size = sprintf(buf, "%s\n", line);
+    else if (i % 64 == 0)
+      size = sprintf(buf, "label loop-%c%c\n", PIPELINE_MOCK_LABEL(i / 64));
+    else if (i % 64 == 63)
+      size = sprintf(buf, "  jmp loop-%c%c\n",
+                     PIPELINE_MOCK_LABEL((i / 64 + 7) % 64));
+    else
+      size = sprintf(buf, "  push %lu\n  dup 0\n  mult\n  pop\n", i);
+    darr_mem_append(&text, buf, size);
+  }
+  buffer_t buffer = buffer_read_cstr("*test-pipeline*", text.data, text.used);
+  darr_free(&text);
+  return buffer;
+}
+
+typedef struct
+{
+  lerr_t lerr;
+  perr_t perr;
+  op_t *program;
+  u64 size;
+  // Where the error was reported
+  char *message;
+  size_t line, column;
+} pipeline_result_t;
+
+// Assemble buffer with tokenise_buffer then parse_stream, or through
+// the pipeline
+pipeline_result_t pipeline_run(buffer_t *buffer, bool pipelined)
+{
+  pipeline_result_t res = {.lerr = LERR_OK, .perr = PERR_OK};
+  stream_t stream       = {0};
+  buffer->cur           = 0;
+  if (pipelined)
+  {
+    pipeline_stats_t stats[NUMBER_OF_PIPELINE_STAGES] = {0};
+    res.perr =
+        pipeline_assemble(buffer, &stream, &res.program, &res.size, stats);
+    res.lerr = stream.lerr;
+    if (res.lerr != LERR_OK)
+      res.message = stream_lerr_generate(&stream);
+  }
+  else
+  {
+    res.lerr = tokenise_buffer(&stream, buffer);
+    if (res.lerr != LERR_OK)
+      res.message = lerr_generate(res.lerr, buffer);
+    else
+      res.perr = parse_stream(&stream, &res.program, &res.size);
+  }
+  if (res.lerr == LERR_OK && res.perr != PERR_OK)
+    stream_position(&stream, stream.cursor, &res.line, &res.column);
+  stream_free(&stream);
+  return res;
+}
+
+void pipeline_result_free(pipeline_result_t *res)
+{
+  free(res->program);
+  free(res->message);
+}
+
+bool test_pipeline_matches(void)
+{
+  buffer_t buffer              = pipeline_mock_source(NULL);
+  pipeline_result_t sequential = pipeline_run(&buffer, false);
+  pipeline_result_t pipelined  = pipeline_run(&buffer, true);
+
+  ASSERT(test_matches_ok, sequential.perr == PERR_OK &&
+                              pipelined.perr == PERR_OK &&
+                              pipelined.lerr == LERR_OK);
+  bool same = test_matches_ok && sequential.size == pipelined.size;
+  for (u64 i = 0; same && i < sequential.size; ++i)
+    same = sequential.program[i].opcode == pipelined.program[i].opcode &&
+           sequential.program[i].operand == pipelined.program[i].operand;
+  ASSERT(test_matches_program, same);
+
+  pipeline_result_free(&sequential);
+  pipeline_result_free(&pipelined);
+  free(buffer.data);
+  return test_matches_ok && test_matches_program;
+}
+
+bool test_pipeline_lexer_error(void)
+{
+  buffer_t buffer              = pipeline_mock_source("  push 'ab'");
+  pipeline_result_t sequential = pipeline_run(&buffer, false);
+  pipeline_result_t pipelined  = pipeline_run(&buffer, true);
+
+  // The lexer stops the pipeline part way, at the same place
+  ASSERT(test_lexer_error_found, sequential.lerr == LERR_CHAR_WRONG_SIZE &&
+                                     pipelined.lerr == sequential.lerr);
+  ASSERT(test_lexer_error_message,
+         test_lexer_error_found &&
+             strcmp(sequential.message, pipelined.message) == 0);
+
+  pipeline_result_free(&sequential);
+  pipeline_result_free(&pipelined);
+  free(buffer.data);
+  return test_lexer_error_found && test_lexer_error_message;
+}
+
+bool test_pipeline_parser_error(void)
+{
+  buffer_t buffer              = pipeline_mock_source("  dup 'a'");
+  pipeline_result_t sequential = pipeline_run(&buffer, false);
+  pipeline_result_t pipelined  = pipeline_run(&buffer, true);
+
+  ASSERT(test_parser_error_found, sequential.perr == PERR_EXPECTED_NUMBER &&
+                                      pipelined.perr == sequential.perr &&
+                                      pipelined.lerr == LERR_OK);
+  ASSERT(test_parser_error_position,
+         sequential.line != 0 && pipelined.line == sequential.line &&
+             pipelined.column == sequential.column);
+
+  pipeline_result_free(&sequential);
+  pipeline_result_free(&pipelined);
+  free(buffer.data);
+  return test_parser_error_found && test_parser_error_position;
+}
@@ -0,0 +1,16 @@
+#ifndef TEST_PIPELINE_H
+#define TEST_PIPELINE_H
+
+#include "./test.h"
+
+bool test_pipeline_matches(void);
+bool test_pipeline_lexer_error(void);
+bool test_pipeline_parser_error(void);
+
+static const test_t TEST_PIPELINE_SUITE[] = {
+    CREATE_TEST(test_pipeline_matches),
+    CREATE_TEST(test_pipeline_lexer_error),
+    CREATE_TEST(test_pipeline_parser_error),
+};
+
+#endif
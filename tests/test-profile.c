@@ -0,0 +1,126 @@
+/* test-profile.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Unit tests for profile.h
+ */
+
+#include "./test-profile.h"
+#include "./test.h"
+
+#include "../src/profile.h"
+
+#include <stdio.h>
+
+#define PROFILE_MOCK_FILE "tests/TEST_PROFILE_MOCK_FILE.txt"
+
+#define JMP(N)  OP_CREATE_JMP(data_uint(N))
+#define ADDR(N) OP_CREATE_PUSH(data_uint(N))
+
+#define PROFILE_MOCK_SIZE 8
+
+// Profile a run of a subroutine at 6 called twice, returning through
+// `jmp *` to 3 then 5
+err_t profile_mock(profile_t *prof)
+{
+  // 0: push 3, 1: jmp 6, 2: halt, 3: push 5, 4: jmp 6, 5: halt, 6: noop,
+  // 7: jmp *
+  op_t program[PROFILE_MOCK_SIZE] = {
+      ADDR(3),        JMP(6), OP_CREATE_HALT,
+      ADDR(5),        JMP(6), OP_CREATE_HALT,
+      OP_CREATE_NOOP, OP_CREATE_JMP(data_nil()),
+  };
+  vm_t vm = {0};
+  vm_copy_program(&vm, program, ARR_SIZE(program));
+  profile_init(prof, &vm);
+  err_t err = profile_execute_all(prof, &vm);
+  vm_free(&vm);
+  return err;
+}
+
+// Count of the edge (from, to), or 0 if it was never taken
+u64 profile_edge_count(profile_t *prof, word from, word to)
+{
+  for (size_t i = 0; i < prof->edges.used; ++i)
+  {
+    profile_edge_t edge = DARR_MEMBER(&prof->edges, profile_edge_t, i);
+    if (edge.from == from && edge.to == to)
+      return edge.count;
+  }
+  return 0;
+}
+
+bool test_profile_blocks(void)
+{
+  profile_t prof = {0};
+  ASSERT(test_blocks_run, profile_mock(&prof) == ERR_OK);
+
+  // Leaders: the entry, after each jump, the targets and return sites
+  ASSERT(test_blocks_count, prof.blocks == 5);
+  ASSERT(test_blocks_leaders,
+         prof.leaders[0] == 0 && prof.leaders[1] == 2 && prof.leaders[2] == 3 &&
+             prof.leaders[3] == 5 && prof.leaders[4] == 6);
+  // The subroutine is entered twice.  The halt at 2 is never reached
+  // and the one at 5 ends the run before it would be counted
+  ASSERT(test_blocks_counts,
+         prof.block_counts[0] == 1 && prof.block_counts[1] == 0 &&
+             prof.block_counts[2] == 1 && prof.block_counts[3] == 0 &&
+             prof.block_counts[4] == 2);
+
+  profile_free(&prof);
+  return test_blocks_run && test_blocks_count && test_blocks_leaders &&
+         test_blocks_counts;
+}
+
+bool test_profile_edges(void)
+{
+  profile_t prof = {0};
+  ASSERT(test_edges_run, profile_mock(&prof) == ERR_OK);
+
+  ASSERT(test_edges_static, profile_edge_count(&prof, 1, 6) == 1 &&
+                                profile_edge_count(&prof, 4, 6) == 1);
+  // `jmp *` changes target, so gets an edge per target
+  ASSERT(test_edges_dynamic, prof.edges.used == 4 &&
+                                 profile_edge_count(&prof, 7, 3) == 1 &&
+                                 profile_edge_count(&prof, 7, 5) == 1);
+  // Going back to a target it had before finds the same edge
+  profile_record_edge(&prof, 7, 3);
+  ASSERT(test_edges_again, prof.edges.used == 4 &&
+                               profile_edge_count(&prof, 7, 3) == 2);
+
+  profile_free(&prof);
+  return test_edges_run && test_edges_static && test_edges_dynamic &&
+         test_edges_again;
+}
+
+bool test_profile_write(void)
+{
+  profile_t prof = {0};
+  profile_mock(&prof);
+  FILE *fp = fopen(PROFILE_MOCK_FILE, "w");
+  profile_write(&prof, fp);
+  fclose(fp);
+  // Writing sorts the edges, which mustn't lose track of them
+  profile_record_edge(&prof, 7, 5);
+  ASSERT(test_write_sorted, prof.edges.used == 4 &&
+                                profile_edge_count(&prof, 7, 5) == 2);
+
+  u64 block_counts[PROFILE_MOCK_SIZE] = {0};
+  u64 jump_counts[PROFILE_MOCK_SIZE]  = {0};
+  fp = fopen(PROFILE_MOCK_FILE, "r");
+  ASSERT(test_write_read, profile_read(fp, PROFILE_MOCK_SIZE, block_counts,
+                                       jump_counts));
+  fclose(fp);
+  ASSERT(test_write_counts, block_counts[6] == 2 && block_counts[2] == 0 &&
+                                jump_counts[1] == 1 && jump_counts[4] == 1 &&
+                                jump_counts[7] == 2);
+  // A profile of some other program is refused
+  fp = fopen(PROFILE_MOCK_FILE, "r");
+  ASSERT(test_write_size,
+         !profile_read(fp, PROFILE_MOCK_SIZE + 1, block_counts, jump_counts));
+  fclose(fp);
+
+  remove(PROFILE_MOCK_FILE);
+  profile_free(&prof);
+  return test_write_sorted && test_write_read && test_write_counts &&
+         test_write_size;
+}
@@ -0,0 +1,16 @@
+#ifndef TEST_PROFILE_H
+#define TEST_PROFILE_H
+
+#include "./test.h"
+
+bool test_profile_blocks(void);
+bool test_profile_edges(void);
+bool test_profile_write(void);
+
+static const test_t TEST_PROFILE_SUITE[] = {
+    CREATE_TEST(test_profile_blocks),
+    CREATE_TEST(test_profile_edges),
+    CREATE_TEST(test_profile_write),
+};
+
+#endif
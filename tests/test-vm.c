@@ -0,0 +1,104 @@
+/* test-vm.c
+ * Created: 2026-10-19
+ * Author: Aryadev Chavali
+ * Description: Unit tests for vm.h
+ */
+
+#include "./test-vm.h"
+#include "./test.h"
+
+#include "../src/vm.h"
+
+#define VM_MOCK_SIZE 7
+
+// 0: push 1, 1: jmp 3, 2: print, 3: dup 0, 4: plus, 5: pop, 6: halt
+void vm_mock(vm_t *vm)
+{
+  op_t program[VM_MOCK_SIZE] = {
+      OP_CREATE_PUSH(data_int(1)),
+      OP_CREATE_JMP(data_uint(3)),
+      OP_CREATE_PRINT,
+      OP_CREATE_DUP(data_uint(0)),
+      OP_CREATE_PLUS,
+      OP_CREATE_POP,
+      OP_CREATE_HALT,
+  };
+  *vm = (vm_t){0};
+  vm_copy_program(vm, program, VM_MOCK_SIZE);
+}
+
+// Addresses a hook was called at, stopping with stop_err at stop_at
+typedef struct
+{
+  word seen[VM_MOCK_SIZE];
+  size_t count;
+  bool opcodes_match;
+  word stop_at;
+  err_t stop_err;
+} vm_mock_hook_t;
+
+err_t vm_mock_hook(vm_t *vm, op_t op, void *data)
+{
+  vm_mock_hook_t *hook = data;
+  if (vm->iptr == hook->stop_at)
+    return hook->stop_err;
+  hook->opcodes_match =
+      hook->opcodes_match && op.opcode == vm->program[vm->iptr].opcode;
+  if (hook->count < VM_MOCK_SIZE)
+    hook->seen[hook->count++] = vm->iptr;
+  return ERR_OK;
+}
+
+bool test_vm_hook_every(void)
+{
+  vm_t vm             = {0};
+  vm_mock_hook_t hook = {.opcodes_match = true, .stop_at = VM_MOCK_SIZE};
+  vm_mock(&vm);
+  vm_set_hook(&vm, vm_mock_hook, &hook);
+
+  ASSERT(test_every_run, vm_execute_all(&vm) == ERR_OK);
+  // Everything executed, in order, skipping what was jumped over
+  ASSERT(test_every_seen, hook.count == 5 && hook.count == vm.stats.retired &&
+                              hook.seen[0] == 0 && hook.seen[1] == 1 &&
+                              hook.seen[2] == 3 && hook.seen[3] == 4 &&
+                              hook.seen[4] == 5);
+  ASSERT(test_every_opcodes, hook.opcodes_match);
+
+  vm_free(&vm);
+  return test_every_run && test_every_seen && test_every_opcodes;
+}
+
+bool test_vm_hook_abort(void)
+{
+  vm_t vm             = {0};
+  vm_mock_hook_t hook = {
+      .opcodes_match = true, .stop_at = 4, .stop_err = ERR_ILLEGAL_JUMP};
+  vm_mock(&vm);
+  vm_set_hook(&vm, vm_mock_hook, &hook);
+
+  ASSERT(test_abort_error, vm_execute_all(&vm) == ERR_ILLEGAL_JUMP &&
+                               vm.stats.error == ERR_ILLEGAL_JUMP);
+  // The plus the hook stopped at was never executed
+  ASSERT(test_abort_before, vm.iptr == 4 && vm.sptr == 2 &&
+                                vm.stats.retired == 3 && hook.count == 3);
+
+  vm_free(&vm);
+  return test_abort_error && test_abort_before;
+}
+
+bool test_vm_hook_null(void)
+{
+  vm_t vm             = {0};
+  vm_mock_hook_t hook = {.opcodes_match = true, .stop_at = VM_MOCK_SIZE};
+  vm_mock(&vm);
+  vm_set_hook(&vm, vm_mock_hook, &hook);
+  vm_set_hook(&vm, NULL, &hook);
+
+  ASSERT(test_null_cleared, vm.dispatch == VM_DISPATCH && vm.hook == NULL &&
+                                vm.hook_data == NULL);
+  ASSERT(test_null_run, vm_execute_all(&vm) == ERR_OK &&
+                            vm.stats.retired == 5 && hook.count == 0);
+
+  vm_free(&vm);
+  return test_null_cleared && test_null_run;
+}
@@ -0,0 +1,16 @@
+#ifndef TEST_VM_H
+#define TEST_VM_H
+
+#include "./test.h"
+
+bool test_vm_hook_every(void);
+bool test_vm_hook_abort(void);
+bool test_vm_hook_null(void);
+
+static const test_t TEST_VM_SUITE[] = {
+    CREATE_TEST(test_vm_hook_every),
+    CREATE_TEST(test_vm_hook_abort),
+    CREATE_TEST(test_vm_hook_null),
+};
+
+#endif
@@ -8,10 +8,16 @@
 #include "../src/parser.h"
 #include "../src/vm.h"
 
+#include "./test-cache.h"
+#include "./test-cfg.h"
 #include "./test-lexer.h"
 #include "./test-lib.h"
 #include "./test-op.h"
-/* #include "./test-parser.h" */
+#include "./test-optimiser.h"
+#include "./test-parser.h"
+#include "./test-pipeline.h"
+#include "./test-profile.h"
+#include "./test-vm.h"
 #include "./test.h"
 
 #include <assert.h>
@@ -97,12 +103,29 @@ int main(void)
   bool lexer_passed =
       run_test_suite("LEXER", TEST_LEXER_SUITE, ARR_SIZE(TEST_LEXER_SUITE));
   puts("----------------------------------------------------------------");
-  /* bool parser_passed = */
-  /*     run_test_suite("PARSER", TEST_PARSER_SUITE,
-   * ARR_SIZE(TEST_PARSER_SUITE)); */
-  /* puts("----------------------------------------------------------------");
-   */
-  if (lib_passed && op_passed && lexer_passed)
+  bool cfg_passed =
+      run_test_suite("CFG", TEST_CFG_SUITE, ARR_SIZE(TEST_CFG_SUITE));
+  puts("----------------------------------------------------------------");
+  bool optimiser_passed = run_test_suite("OPTIMISER", TEST_OPTIMISER_SUITE,
+                                         ARR_SIZE(TEST_OPTIMISER_SUITE));
+  puts("----------------------------------------------------------------");
+  bool cache_passed =
+      run_test_suite("CACHE", TEST_CACHE_SUITE, ARR_SIZE(TEST_CACHE_SUITE));
+  puts("----------------------------------------------------------------");
+  bool parser_passed =
+      run_test_suite("PARSER", TEST_PARSER_SUITE, ARR_SIZE(TEST_PARSER_SUITE));
+  puts("----------------------------------------------------------------");
+  bool pipeline_passed = run_test_suite("PIPELINE", TEST_PIPELINE_SUITE,
+                                        ARR_SIZE(TEST_PIPELINE_SUITE));
+  puts("----------------------------------------------------------------");
+  bool profile_passed = run_test_suite("PROFILE", TEST_PROFILE_SUITE,
+                                       ARR_SIZE(TEST_PROFILE_SUITE));
+  puts("----------------------------------------------------------------");
+  bool vm_passed = run_test_suite("VM", TEST_VM_SUITE, ARR_SIZE(TEST_VM_SUITE));
+  puts("----------------------------------------------------------------");
+  if (lib_passed && op_passed && lexer_passed && cfg_passed &&
+      optimiser_passed && cache_passed && parser_passed && pipeline_passed &&
+      profile_passed && vm_passed)
     return 0;
   else
     return 1;